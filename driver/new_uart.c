@@ -21,10 +21,14 @@
 #include "driver/uart_register.h"
 #include "mem.h"
 #include "os_type.h"
+#include "cpu_stats.h"
+#include "task_post.h"
 
 #ifdef _ENABLE_RING_BUFFER
     static ringbuf_t rxBuff;
     static ringbuf_t txBuff;
+    /* Bytes queued by UART_Send, moved into the Tx FIFO by the interrupt */
+    static ringbuf_t txRing;
 #endif
 
 #ifdef _ENABLE_CONSOLE_INTEGRATION
@@ -39,6 +43,11 @@ static uint8 uart_recvTaskPrio = 0;
 /* Internal Functions */
 static  void ICACHE_FLASH_ATTR uart_config(uint8 uart_no);
 static  void uart0_rx_intr_handler(void *para);
+static  void uart_tx_burst(uint8 uart, const uint8 *buf, uint16 len);
+static  void uart_tx_fill_fifo(uint8 uart_no);
+#if _ENABLE_RING_BUFFER == 1
+static  void uart0_rx_drain(uint8 uart_no);
+#endif
 
 /* Public APIs */
 void ICACHE_FLASH_ATTR UART_init(UartBautRate uart0_br, UartBautRate uart1_br, uint8 recv_task_priority);
@@ -67,6 +76,7 @@ void ICACHE_FLASH_ATTR UART_init_console(UartBautRate uart0_br,
     UartDev.baut_rate = uart0_br;
     rxBuff = rxbuffer;
     txBuff = txBuffer;
+    txRing = ringbuf_new(TX_RING_BUFFER_SIZE);
     linked_to_console = 1;
 
     uart_config(UART0);
@@ -97,6 +107,7 @@ void ICACHE_FLASH_ATTR UART_init(UartBautRate uart0_br, UartBautRate uart1_br, u
     #if _ENABLE_CONSOLE_INTEGRATION == 0
         #if _ENABLE_RING_BUFFER == 1
             rxBuff = ringbuf_new(RX_RING_BUFFER_SIZE);
+            txRing = ringbuf_new(TX_RING_BUFFER_SIZE);
         #endif
     #endif
 }
@@ -148,7 +159,8 @@ LOCAL void ICACHE_FLASH_ATTR uart_config(uint8 uart_no)
         int rx_threshold = 10;
 
         #if _ENABLE_CONSOLE_INTEGRATION == 1
-            rx_threshold = 1;
+            /* Typed input that does not reach it is picked up by RX TOUT */
+            rx_threshold = 32;
         #endif
 
         //set rx fifo trigger
@@ -158,8 +170,8 @@ LOCAL void ICACHE_FLASH_ATTR uart_config(uint8 uart_no)
                         ((110 & UART_RX_FLOW_THRHD) << UART_RX_FLOW_THRHD_S) |
                         UART_RX_FLOW_EN |   //enbale rx flow control
                         #endif
-//                        (0x02 & UART_RX_TOUT_THRHD) << UART_RX_TOUT_THRHD_S |
-//                        UART_RX_TOUT_EN|
+                        (0x02 & UART_RX_TOUT_THRHD) << UART_RX_TOUT_THRHD_S |
+                        UART_RX_TOUT_EN|
                         ((0x10 & UART_TXFIFO_EMPTY_THRHD)<<UART_TXFIFO_EMPTY_THRHD_S));//wjl
                         #if UART_HW_CTS
                         SET_PERI_REG_MASK( UART_CONF0(uart_no),UART_TX_FLOW_EN);  //add this sentense to add a tx flow control via MTCK( CTS )
@@ -193,15 +205,8 @@ int UART_Recv(uint8 uart_no, char *buffer, int max_buf_len)
 
     #if _ENABLE_RING_BUFFER == 1
     /* If the ring buffer is enabled, then unload from Rx Ring Buffer */
-    uint8 bytes_ringbuffer = ringbuf_bytes_used(rxBuff);
-
-    //ring_buffer_dump(rxBuff);
-    if (bytes_ringbuffer)
-    {
-        max_unload = (bytes_ringbuffer<max_buf_len ? bytes_ringbuffer: max_buf_len);
-
-	ringbuf_memcpy_from(buffer, rxBuff, max_unload);
-    }
+    /* The Rx interrupt is the producer, this side only moves the tail */
+    index = ringbuf_spsc_get(buffer, rxBuff, max_buf_len);
     #else
     /* If the ring buffer is not enabled, then unload from Rx FIFO */
     uint8 fifo_len = (READ_PERI_REG(UART_STATUS(uart_no))>>UART_RXFIFO_CNT_S)&UART_RXFIFO_CNT;
@@ -229,12 +234,26 @@ int UART_Send(uint8 uart_no, char *buffer, int len)
     int     index = 0;
     char    ch ;
 
+    #if _ENABLE_RING_BUFFER == 1
+    /* Queue for the Tx FIFO empty interrupt, only wait if the ring is full */
+    while (uart_no == UART0 && txRing != NULL && index < len)
+    {
+        /* The Rx interrupt queues its echo into the ring as well, and the
+         * handler clears the enable bit: keep it out while we do both */
+        ETS_UART_INTR_DISABLE();
+        index += ringbuf_spsc_put(txRing, buffer + index, len - index);
+        SET_PERI_REG_MASK(UART_INT_ENA(uart_no), UART_TXFIFO_EMPTY_INT_ENA);
+        ETS_UART_INTR_ENABLE();
+    }
+    #endif
+
     //DBG1("Sending: %s\n", buffer);
-    for (index=0; index <len; index ++)
+    for (; index <len; index ++)
     {
         ch = *(buffer+index);
         uart_tx_one_char(uart_no, ch);
     }
+    return index;
 }
 
 /*---------------------------------------------------------------------------*
@@ -272,6 +291,60 @@ void uart_rx_intr_enable(uint8 uart_no)
 #endif
 }
 
+#if _ENABLE_RING_BUFFER == 1
+/******************************************************************************
+ * FunctionName : uart0_rx_drain
+ * Description  : Internal used function
+ *                Unloads the whole Rx FIFO and hands it on in one go, for both
+ *                the FIFO full and the Rx timeout interrupt
+ * Parameters   : uint8 uart_no - always UART0
+ * Returns      : NONE
+*******************************************************************************/
+static void uart0_rx_drain(uint8 uart_no)
+{
+    uint8_t burst[UART_FIFO_LEN];
+    uint8_t got_cr = 0;
+    uint16_t index;
+    uint16_t fifo_len = (READ_PERI_REG(UART_STATUS(uart_no))>>UART_RXFIFO_CNT_S)&UART_RXFIFO_CNT;
+    //DBG1("RX FIFO [%d]\r\n", fifo_len );
+
+    if (fifo_len)
+    {
+        if (fifo_len > sizeof(burst))
+        {
+            fifo_len = sizeof(burst);
+        }
+        for (index=0;index<fifo_len; index++)
+        {
+            burst[index] = (READ_PERI_REG(UART_FIFO(UART0)) & 0xFF);
+            got_cr |= (burst[index] == '\r');
+        }
+
+        ringbuf_spsc_put(rxBuff, burst, fifo_len);
+        #if _ENABLE_CONSOLE_INTEGRATION == 1
+        /* Echo behind the output already queued. Drop it if the Tx ring
+         * has no room, rather than wait for the FIFO in the interrupt */
+        if (txRing != NULL && ringbuf_bytes_free(txRing) >= fifo_len)
+        {
+            ringbuf_spsc_put(txRing, burst, fifo_len);
+            SET_PERI_REG_MASK(UART_INT_ENA(uart_no), UART_TXFIFO_EMPTY_INT_ENA);
+        }
+        if (got_cr)
+        {
+            task_post_intr(SIG_CONSOLE_RX, 0);
+        }
+        #else
+        system_os_post(uart_recvTaskPrio, SIG_UART0, 0);
+        #endif
+    }
+
+    /* The FIFO is empty now, neither interrupt is pending any more */
+    WRITE_PERI_REG(UART_INT_CLR(uart_no),
+                   UART_RXFIFO_FULL_INT_CLR | UART_RXFIFO_TOUT_INT_CLR);
+    uart_rx_intr_enable(uart_no);
+}
+#endif
+
 /******************************************************************************
  * FunctionName : uart0_rx_intr_handler
  * Description  : Internal used function
@@ -282,6 +355,7 @@ void uart_rx_intr_enable(uint8 uart_no)
 static void uart0_rx_intr_handler(void *para)
 {
     uint8 uart_no = UART0;//UartDev.buff_uart_no;
+    CPU_ENTER(cpu);
 
 	/* Is the frame Error interrupt set ? */
     if(UART_FRM_ERR_INT_ST == (READ_PERI_REG(UART_INT_ST(uart_no)) & UART_FRM_ERR_INT_ST))
@@ -296,35 +370,7 @@ static void uart0_rx_intr_handler(void *para)
     {
         /* Rx FIFO is full, hence the interrupt */
         #if _ENABLE_RING_BUFFER == 1
-        uint16_t index;
-        uint16_t fifo_len = (READ_PERI_REG(UART_STATUS(uart_no))>>UART_RXFIFO_CNT_S)&UART_RXFIFO_CNT;
-        //DBG1("RX FIFO FULL [%d]\r\n", fifo_len );
-
-        if (fifo_len)
-        {
-            //DBG1("Rx Fifo contains %d characters have to unload\r\n", fifo_len);
-
-            for (index=0;index<fifo_len; index++)
-            {
-                uint8_t ch = (READ_PERI_REG(UART_FIFO(UART0)) & 0xFF);
-
-                //if (ch == '\r') ch = '\n';
-	        ringbuf_memcpy_into(rxBuff, &ch, 1);
-                #if _ENABLE_CONSOLE_INTEGRATION == 1
-                uart_tx_one_char(uart_no, ch);
-                if (ch == '\r')
-                {
-                    system_os_post(0, SIG_CONSOLE_RX, 0);
-                }
-                #endif
-            }
-
-            WRITE_PERI_REG(UART_INT_CLR(uart_no), UART_RXFIFO_FULL_INT_CLR);
-            uart_rx_intr_enable(uart_no);
-            #if _ENABLE_CONSOLE_INTEGRATION == 0
-                system_os_post(uart_recvTaskPrio, SIG_UART0, 0);
-            #endif
-        }
+        uart0_rx_drain(uart_no);
         #else
         DBG1("RX FIFO FULL [%d]\r\n", (READ_PERI_REG(UART_STATUS(uart_no))>>UART_RXFIFO_CNT_S)& UART_RXFIFO_CNT);
         uart_rx_intr_disable(UART0);
@@ -339,18 +385,26 @@ static void uart0_rx_intr_handler(void *para)
     {
         /* The Time out threshold for Rx/Tx is being execeeded */
         DBG1("Rx Timeout Threshold not being met \r\n");
+        #if _ENABLE_RING_BUFFER == 1
+        /* Fewer bytes than the threshold, and then a pause */
+        uart0_rx_drain(uart_no);
+        #else
         uart_rx_intr_disable(UART0);
         WRITE_PERI_REG(UART_INT_CLR(UART0), UART_RXFIFO_TOUT_INT_CLR);
 
         system_os_post(uart_recvTaskPrio, SIG_UART0, 0);
+        #endif
         goto end_int_handler;
     }
 
     if(UART_TXFIFO_EMPTY_INT_ST == (READ_PERI_REG(UART_INT_ST(uart_no)) & UART_TXFIFO_EMPTY_INT_ST))
     {
         /* The Tx FIFO is empty, the FIFO needs to be fed with new data */
-        DBG1("Tx FIFO is empty\r\n");
+        #if _ENABLE_RING_BUFFER == 1
+        uart_tx_fill_fifo(uart_no);
+        #else
         CLEAR_PERI_REG_MASK(UART_INT_ENA(UART0), UART_TXFIFO_EMPTY_INT_ENA);
+        #endif
 
         #if UART_BUFF_EN
             tx_start_uart_buffer(UART0);
@@ -360,9 +414,37 @@ static void uart0_rx_intr_handler(void *para)
     }
 
 end_int_handler:
+    CPU_EXIT(cpu, CPU_UART_ISR);
     return;
 }
 
+/******************************************************************************
+ * FunctionName : uart_tx_fill_fifo
+ * Description  : Internal used function
+ *                move as much of the Tx ring as fits into the Tx FIFO, and
+ *                disable the Tx FIFO empty interrupt once the ring is empty
+ * Parameters   : uint8 uart_no - uart port
+ * Returns      : NONE
+*******************************************************************************/
+static void uart_tx_fill_fifo(uint8 uart_no)
+{
+    uint8 chunk[UART_FIFO_LEN];
+    uint8 fifo_cnt = ((READ_PERI_REG(UART_STATUS(uart_no))>>UART_TXFIFO_CNT_S)& UART_TXFIFO_CNT);
+    uint16 len = 0;
+
+    if (fifo_cnt < 126)
+    {
+        len = ringbuf_spsc_get(chunk, txRing, 126 - fifo_cnt);
+        uart_tx_burst(uart_no, chunk, len);
+    }
+
+    /* UART_Send sets the enable bit again after queueing more */
+    if (ringbuf_is_empty(txRing))
+    {
+        CLEAR_PERI_REG_MASK(UART_INT_ENA(uart_no), UART_TXFIFO_EMPTY_INT_ENA);
+    }
+}
+
 /******************************************************************************
  * FunctionName : uart_tx_one_char_no_wait
  * Description  : uart tx a single char without waiting for fifo
@@ -384,6 +466,41 @@ STATUS uart_tx_one_char(uint8 uart, uint8 TxChar)
 	return OK;
 }
 
+/******************************************************************************
+ * FunctionName : uart_tx_burst
+ * Description  : Internal used function
+ *                write len bytes to the Tx FIFO, checking the fill level
+ *                once per free stretch of FIFO instead of once per byte
+ * Parameters   : uint8 uart - uart port
+ *                const uint8 *buf - bytes to tx
+ *                uint16 len - number of bytes
+ * Returns      : NONE
+*******************************************************************************/
+static void uart_tx_burst(uint8 uart, const uint8 *buf, uint16 len)
+{
+    while (len)
+    {
+        uint8 fifo_cnt = ((READ_PERI_REG(UART_STATUS(uart))>>UART_TXFIFO_CNT_S)& UART_TXFIFO_CNT);
+        uint16 room;
+
+        if (fifo_cnt >= 126)
+        {
+            continue;
+        }
+
+        room = 126 - fifo_cnt;
+        if (room > len)
+        {
+            room = len;
+        }
+        len -= room;
+        while (room--)
+        {
+            WRITE_PERI_REG(UART_FIFO(uart) , *buf++);
+        }
+    }
+}
+
 /******************************************************************************
  * FunctionName : uart_tx_one_char_no_wait
  * Description  : uart tx a single char without waiting for fifo
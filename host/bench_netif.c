@@ -0,0 +1,225 @@
+/*
+ * bench_netif.c - Packet forwarding microbenchmark for the netif hooks.
+ *
+ * Boots the repeater core on the host, lets the simulated station get an
+ * IP and a client join the SoftAP so patch_netif() installs my_input_ap,
+ * my_output_ap, my_input_sta and my_output_sta, and then pushes synthetic
+ * pbuf chains through each hook. The original netif functions are
+ * replaced by sinks beforehand, so the numbers are the cost of the hook
+ * itself plus one indirect call into the sink. A "direct" row calls the
+ * sink without any hook for reference.
+ *
+ *   make -C host bench && ../build/host/bench_netif [-n packets]
+ */
+#include <time.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "mem.h"
+#include "osapi.h"
+#include "lwip/netif.h"
+#include "config_flash.h"
+
+#include "host.h"
+
+// Frames are split into pbufs of at most this size, like a pool chain
+#define BENCH_SEGMENT 512
+
+void user_init(void);
+void user_set_station_config(void);
+
+extern sysconfig_t config;
+
+static volatile uint32_t sink_packets;
+
+// The client that joins the SoftAP, and the SoftAP itself. Frames go
+// between the two, unicast, so the per-station accounting is measured.
+static const uint8_t client_mac[6] = { 0x40, 0xf4, 0x07, 0x00, 0x00, 0x01 };
+static const uint8_t ap_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+static err_t
+bench_input_sink(struct pbuf *p, struct netif *inp)
+{
+  sink_packets++;
+  return ERR_OK;
+}
+
+static err_t
+bench_output_sink(struct netif *outp, struct pbuf *p)
+{
+  sink_packets++;
+  return ERR_OK;
+}
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct pbuf *
+make_frame(u16_t size, const uint8_t *dst, const uint8_t *src)
+{
+  struct pbuf *head = NULL;
+  u16_t left = size;
+
+  while (left > 0)
+  {
+    u16_t n = left > BENCH_SEGMENT ? BENCH_SEGMENT : left;
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+
+    os_memset(p->payload, 0xa5, n);
+    if (head == NULL)
+    {
+      head = p;
+    }
+    else
+    {
+      pbuf_cat(head, p);
+    }
+    left -= n;
+  }
+  // All sizes hold the Ethernet addresses in the first pbuf
+  os_memcpy(head->payload, dst, 6);
+  os_memcpy((uint8_t *)head->payload + 6, src, 6);
+  return head;
+}
+
+static void
+run_until(uint64_t us)
+{
+  uint64_t end = host_time_us() + us;
+
+  while (host_time_us() < end)
+  {
+    host_run_timers();
+    host_run_tasks();
+    usleep(1000);
+  }
+}
+
+static void
+report(const char *name, u16_t size, uint32_t packets, uint64_t ns)
+{
+  double ns_pkt = (double)ns / packets;
+
+  printf("%-14s %5u %9.1f %12.0f %14.0f\n", name, size, ns_pkt,
+         1e9 / ns_pkt, 1e9 / ns_pkt * size);
+}
+
+static void
+bench_input(const char *name, struct netif *nif, netif_input_fn fn,
+            u16_t size, uint32_t packets)
+{
+  struct pbuf *p = make_frame(size, ap_mac, client_mac);
+  uint64_t t0;
+  uint32_t i;
+
+  t0 = now_ns();
+  for (i = 0; i < packets; i++)
+  {
+    fn(p, nif);
+  }
+  report(name, size, packets, now_ns() - t0);
+  pbuf_free(p);
+}
+
+static void
+bench_output(const char *name, struct netif *nif, netif_linkoutput_fn fn,
+             u16_t size, uint32_t packets)
+{
+  struct pbuf *p = make_frame(size, client_mac, ap_mac);
+  uint64_t t0;
+  uint32_t i;
+
+  t0 = now_ns();
+  for (i = 0; i < packets; i++)
+  {
+    fn(nif, p);
+  }
+  report(name, size, packets, now_ns() - t0);
+  pbuf_free(p);
+}
+
+static void
+bench_all(uint32_t packets)
+{
+  static const u16_t sizes[] = { 64, 576, 1500 };
+  struct netif *ap = &host_netif_ap, *sta = &host_netif_sta;
+  int i;
+
+  printf("%-14s %5s %9s %12s %14s\n",
+         "hook", "bytes", "ns/pkt", "pkts/s", "bytes/s");
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    bench_input("direct", ap, bench_input_sink, sizes[i], packets);
+    bench_input("my_input_ap", ap, ap->input, sizes[i], packets);
+    bench_output("my_output_ap", ap, ap->linkoutput, sizes[i], packets);
+    bench_input("my_input_sta", sta, sta->input, sizes[i], packets);
+    bench_output("my_output_sta", sta, sta->linkoutput, sizes[i], packets);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  char flash_file[] = "/tmp/bench_netif.XXXXXX";
+  uint32_t packets = 2000000;
+  uint16_t status_led;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1)
+  {
+    if (opt != 'n')
+    {
+      fprintf(stderr, "usage: %s [-n packets]\n", argv[0]);
+      return 1;
+    }
+    packets = atoi(optarg);
+  }
+
+  // Start from an empty flash, so the default config is used
+  close(mkstemp(flash_file));
+  host_init(flash_file, NULL);
+  host_wifi_init();
+  system_set_os_print(0);
+  user_init();
+
+  // The hooks keep whatever input/linkoutput they replace as orig_*
+  host_netif_sta.input = bench_input_sink;
+  host_netif_sta.linkoutput = bench_output_sink;
+  os_sprintf(config.ssid, "bench");
+  user_set_station_config();
+  wifi_station_connect();
+  run_until(600000);
+
+  host_netif_ap.input = bench_input_sink;
+  host_netif_ap.linkoutput = bench_output_sink;
+  host_wifi_station_join(client_mac);
+  unlink(flash_file);
+
+  if (host_netif_ap.input == bench_input_sink ||
+      host_netif_sta.input == bench_input_sink)
+  {
+    fprintf(stderr, "netif hooks were not installed\n");
+    return 1;
+  }
+
+  status_led = config.status_led;
+  printf("status_led %d (%u packets per run)\n", status_led, packets);
+  host_gpio_writes = 0;
+  bench_all(packets);
+  printf("GPIO writes: %u\n\n", host_gpio_writes);
+
+  config.status_led = 0xff;
+  printf("status_led disabled (%u packets per run)\n", packets);
+  host_gpio_writes = 0;
+  bench_all(packets);
+  printf("GPIO writes: %u\n", host_gpio_writes);
+  config.status_led = status_led;
+
+  return 0;
+}
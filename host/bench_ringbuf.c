@@ -0,0 +1,143 @@
+/*
+ * bench_ringbuf.c - Throughput of the power-of-two ring buffer against
+ * the previous modulo based one (ringbuf_legacy.c).
+ *
+ * "byte" pushes single bytes the way the UART RX interrupt does and
+ * drains a line at a time like console_handle_command; "bulk" moves
+ * 37 byte chunks in and out so both wrap paths get exercised. The
+ * capacities are the ones the firmware uses for the console RX, UART RX
+ * and console TX buffers.
+ *
+ *   make -C host bench && ../build/host/bench_ringbuf [-n bytes]
+ */
+#include <time.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "ringbuf.h"
+
+#include "ringbuf_legacy.h"
+
+#define BENCH_LINE  64
+#define BENCH_CHUNK 37
+
+static uint8_t data[BENCH_LINE];
+static uint8_t out[BENCH_LINE];
+static volatile uint8_t sink;
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+report(const char *impl, const char *mode, size_t capacity, uint32_t bytes,
+       uint64_t ns)
+{
+  printf("%-8s %-5s %5u %8.2f %10.1f\n", impl, mode, (unsigned)capacity,
+         (double)ns / bytes, bytes * 1e3 / ns);
+}
+
+static void
+bench_byte(size_t capacity, uint32_t bytes)
+{
+  ringbuf_t rb = ringbuf_new(capacity);
+  legacy_ringbuf_t lrb = legacy_ringbuf_new(capacity);
+  size_t line = capacity < BENCH_LINE ? capacity / 2 : BENCH_LINE;
+  uint64_t t0;
+  uint32_t i;
+
+  t0 = now_ns();
+  for (i = 0; i < bytes; i++)
+  {
+    legacy_ringbuf_memcpy_into(lrb, &data[i % line], 1);
+    if (legacy_ringbuf_bytes_used(lrb) == line)
+    {
+      legacy_ringbuf_memcpy_from(out, lrb, line);
+      sink += out[0];
+    }
+  }
+  report("legacy", "byte", capacity, bytes, now_ns() - t0);
+
+  t0 = now_ns();
+  for (i = 0; i < bytes; i++)
+  {
+    ringbuf_memcpy_into(rb, &data[i % line], 1);
+    if (ringbuf_bytes_used(rb) == line)
+    {
+      ringbuf_memcpy_from(out, rb, line);
+      sink += out[0];
+    }
+  }
+  report("pow2", "byte", capacity, bytes, now_ns() - t0);
+
+  legacy_ringbuf_free(lrb);
+  ringbuf_free(&rb);
+}
+
+static void
+bench_bulk(size_t capacity, uint32_t bytes)
+{
+  ringbuf_t rb = ringbuf_new(capacity);
+  legacy_ringbuf_t lrb = legacy_ringbuf_new(capacity);
+  uint64_t t0;
+  uint32_t i;
+
+  t0 = now_ns();
+  for (i = 0; i < bytes; i += BENCH_CHUNK)
+  {
+    legacy_ringbuf_memcpy_into(lrb, data, BENCH_CHUNK);
+    legacy_ringbuf_memcpy_from(out, lrb, BENCH_CHUNK);
+    sink += out[0];
+  }
+  report("legacy", "bulk", capacity, bytes, now_ns() - t0);
+
+  t0 = now_ns();
+  for (i = 0; i < bytes; i += BENCH_CHUNK)
+  {
+    ringbuf_memcpy_into(rb, data, BENCH_CHUNK);
+    ringbuf_memcpy_from(out, rb, BENCH_CHUNK);
+    sink += out[0];
+  }
+  report("pow2", "bulk", capacity, bytes, now_ns() - t0);
+
+  legacy_ringbuf_free(lrb);
+  ringbuf_free(&rb);
+}
+
+int
+main(int argc, char **argv)
+{
+  static const size_t capacities[] = { 80, 250, 1024 };
+  uint32_t bytes = 20000000;
+  int i, opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1)
+  {
+    if (opt != 'n')
+    {
+      fprintf(stderr, "usage: %s [-n bytes]\n", argv[0]);
+      return 1;
+    }
+    bytes = atoi(optarg);
+  }
+
+  for (i = 0; i < BENCH_LINE; i++)
+  {
+    data[i] = 'a' + i % 26;
+  }
+
+  printf("%-8s %-5s %5s %8s %10s\n", "ring", "mode", "cap", "ns/byte",
+         "MB/s");
+  for (i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++)
+  {
+    bench_byte(capacities[i], bytes);
+    bench_bulk(capacities[i], bytes);
+  }
+  return 0;
+}
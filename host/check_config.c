@@ -0,0 +1,193 @@
+/*
+ * check_config.c - The config log in user/config_flash.c against the
+ * file backed NOR flash of the host build.
+ *
+ * "wrap" saves until the log has gone round all CONFIG_LOG_SECTORS
+ * sectors twice, loading the config back after every save. "torn" cuts
+ * a save short in the middle of its write, as a power loss would, and
+ * checks that the load falls back to the save before and that the next
+ * save is not lost. "legacy" puts a config of an older, shorter layout
+ * into sector FLASH_BLOCK_NO, the way the firmware kept it before the
+ * log, and checks that it is taken over. Exits non-zero on the first
+ * failed check.
+ *
+ *   make -C host check && ../build/host/check_config [-f flash.bin]
+ */
+#include <stddef.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "config_flash.h"
+
+#include "host.h"
+
+// Where config_rec_t keeps the sequence number of a record
+#define REC_SEQ_OFFSET 4
+
+static sysconfig_t config, before, loaded;
+
+static void
+expect(bool ok, const char *check, const char *what)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "%s: %s\n", check, what);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void
+erase_log(void)
+{
+  uint8_t sector;
+
+  for (sector = 0; sector < CONFIG_LOG_SECTORS; sector++)
+  {
+    spi_flash_erase_sector(FLASH_BLOCK_NO + sector);
+  }
+}
+
+// Sequence number of the first record in a log sector
+static uint32_t
+first_seq(uint8_t sector)
+{
+  uint32_t hdr[2];
+
+  spi_flash_read((FLASH_BLOCK_NO + sector) * SPI_FLASH_SEC_SIZE, hdr,
+                 sizeof(hdr));
+  return hdr[REC_SEQ_OFFSET / 4];
+}
+
+static void
+check_wrap(void)
+{
+  uint32_t saves;
+
+  erase_log();
+  expect(config_load(&config) != 0, "wrap", "config on erased flash");
+
+  // The log starts in sector 1, so sector 1 starting with a newer
+  // record than sector 0 means it has gone round twice
+  for (saves = 1; saves < 10000; saves++)
+  {
+    os_sprintf(config.ssid, "ssid %u", saves);
+    if (saves % 16 == 0)
+    {
+      // Now and then a bigger change, that costs a full record
+      os_memset(config.dhcps_p, saves & 0xff, sizeof(config.dhcps_p));
+    }
+    config_save(&config);
+
+    os_memset(&loaded, 0, sizeof(loaded));
+    expect(config_load(&loaded) == 0, "wrap", "no config after a save");
+    expect(os_memcmp(&loaded, &config, sizeof(config)) == 0, "wrap",
+           "config differs after a save");
+
+    if (first_seq(1) != 0xffffffff && first_seq(0) != 0xffffffff &&
+        (int32_t)(first_seq(1) - first_seq(0)) > 0)
+    {
+      break;
+    }
+  }
+  expect(saves < 10000, "wrap", "the log did not wrap");
+  printf("wrap    %u saves\n", saves);
+}
+
+static void
+check_torn(void)
+{
+  int32_t budget;
+
+  // A small delta and a full record, cut at every few bytes
+  for (budget = 0; budget < (int32_t)sizeof(sysconfig_t); budget += 7)
+  {
+    erase_log();
+    config_load(&config);
+    os_sprintf(config.ssid, "before");
+    config_save(&config);
+    before = config;
+
+    os_sprintf(config.ssid, "torn");
+    if (budget % 2)
+    {
+      os_memset(config.dhcps_p, 0x5a, sizeof(config.dhcps_p));
+    }
+    host_flash_write_budget = budget;
+    config_save(&config);
+    host_flash_write_budget = -1;
+
+    // Reboot
+    expect(config_load(&loaded) == 0, "torn", "no config after a cut");
+    expect(os_memcmp(&loaded, &before, sizeof(loaded)) == 0 ||
+           os_memcmp(&loaded, &config, sizeof(loaded)) == 0, "torn",
+           "neither the old nor the new config");
+
+    os_sprintf(loaded.ssid, "after");
+    config_save(&loaded);
+    expect(config_load(&config) == 0 && os_strcmp(config.ssid, "after") == 0,
+           "torn", "the save after a cut is lost");
+  }
+  printf("torn    cut at %d places\n", budget / 7);
+}
+
+static void
+check_legacy(void)
+{
+  uint32_t magic;
+  // Before mac_dwell was added
+  uint16_t old_len = offsetof(sysconfig_t, mac_dwell);
+
+  erase_log();
+  config_load_default(&config);
+  os_sprintf(config.ssid, "legacy");
+  config.ap_watchdog = 600;
+  config.length = old_len;
+  config.mac_dwell = 30;
+  spi_flash_write(FLASH_BLOCK_NO * SPI_FLASH_SEC_SIZE, (uint32 *)&config,
+                  (old_len + 3) & ~3);
+
+  os_memset(&loaded, 0, sizeof(loaded));
+  expect(config_load(&loaded) == 0, "legacy", "old style config not found");
+  expect(os_strcmp(loaded.ssid, "legacy") == 0 && loaded.ap_watchdog == 600,
+         "legacy", "fields of the old layout lost");
+  expect(loaded.length == sizeof(sysconfig_t) && loaded.mac_dwell == 0,
+         "legacy", "new fields not defaulted");
+
+  // The first save leaves the old style config alone
+  loaded.mac_dwell = 45;
+  config_save(&loaded);
+  expect(config_load(&config) == 0 && os_strcmp(config.ssid, "legacy") == 0 &&
+         config.mac_dwell == 45, "legacy", "taken over config not saved");
+  spi_flash_read(FLASH_BLOCK_NO * SPI_FLASH_SEC_SIZE, &magic, sizeof(magic));
+  expect(magic == MAGIC_NUMBER, "legacy", "old style config overwritten");
+  printf("legacy  %d of %d bytes taken over\n", old_len,
+         (int)sizeof(sysconfig_t));
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *flash_file = "check_config.bin";
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        flash_file = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-f flash.bin]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  host_init(flash_file, argv);
+  system_set_os_print(0);
+  check_wrap();
+  check_torn();
+  check_legacy();
+  return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * easygpio.c - Host stand-in for the easygpio library. Pin levels are
+ * only remembered, and writes are counted so the cost of driving the
+ * status LED shows up in benchmarks.
+ */
+#include "c_types.h"
+#include "gpio.h"
+#include "easygpio.h"
+
+#include "host.h"
+
+#define HOST_GPIO_PINS 17
+
+uint32_t host_gpio_writes;
+
+static uint8_t pin_level[HOST_GPIO_PINS];
+
+void
+gpio_init(void)
+{
+}
+
+bool
+easygpio_pinMode(uint8_t gpio_pin, EasyGPIO_PullStatus pullStatus,
+                 EasyGPIO_PinMode pinMode)
+{
+  return gpio_pin < HOST_GPIO_PINS;
+}
+
+void
+easygpio_outputSet(uint8_t gpio_pin, uint8_t value)
+{
+  host_gpio_writes++;
+  if (gpio_pin < HOST_GPIO_PINS)
+  {
+    pin_level[gpio_pin] = value;
+  }
+}
+
+uint8_t
+easygpio_inputGet(uint8_t gpio_pin)
+{
+  return gpio_pin < HOST_GPIO_PINS ? pin_level[gpio_pin] : 0;
+}
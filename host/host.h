@@ -0,0 +1,57 @@
+/*
+ * host.h - Harness interface of the host-native build.
+ *
+ * The host build compiles the ESPerPass user code unchanged against the
+ * stand-in SDK headers in host/include. The functions below are what the
+ * SDK would otherwise do behind the application's back: run the timer
+ * list, dispatch task queues, feed the UART and raise WiFi events.
+ */
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include "c_types.h"
+#include "lwip/netif.h"
+
+// Monotonic time since host_init() in us
+uint64_t host_time_us(void);
+
+// Open the flash and RTC memory images, must run before user_init()
+void host_init(const char *flash_file, char **argv);
+
+// Call the system_init_done_cb() callback, as the SDK does after user_init()
+void host_init_done(void);
+
+// Run all expired os_timers, returns the number of callbacks made
+int host_run_timers(void);
+
+// Dispatch all posted task events, returns the number of events handled
+int host_run_tasks(void);
+
+// Microseconds until the next armed os_timer expires, -1 if none
+int64_t host_next_timer_us(void);
+
+// Feed bytes to the console as if they arrived on UART0
+void host_uart_rx(const char *buf, size_t len);
+
+// Bring up the simulated netifs, as the SDK does before user_init()
+void host_wifi_init(void);
+
+// Simulate a station joining / leaving the SoftAP
+void host_wifi_station_join(const uint8_t *mac);
+void host_wifi_station_leave(const uint8_t *mac);
+
+// The simulated station and SoftAP interfaces
+extern struct netif host_netif_sta;
+extern struct netif host_netif_ap;
+
+// Number of GPIO writes seen by the easygpio stand-in
+extern uint32_t host_gpio_writes;
+
+// Number of WiFi settings the SDK would have written to its flash sectors
+extern uint32_t host_wifi_flash_writes;
+
+// Bytes spi_flash_write still writes before it stops short, as if the
+// power had failed, and fails from then on. Negative for no limit.
+extern int32_t host_flash_write_budget;
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * cc.h - Host stand-in for the lwIP architecture types.
+ */
+#ifndef _HOST_ARCH_CC_H_
+#define _HOST_ARCH_CC_H_
+
+#include "c_types.h"
+
+typedef uint8_t  u8_t;
+typedef int8_t   s8_t;
+typedef uint16_t u16_t;
+typedef int16_t  s16_t;
+typedef uint32_t u32_t;
+typedef int32_t  s32_t;
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * c_types.h - Host stand-in for the ESP8266 SDK base types.
+ *
+ * Only what the ESPerPass sources use is provided here. Pointer sized
+ * values (ETSParam) are widened to uintptr_t since the host is 64 bit.
+ */
+#ifndef _HOST_C_TYPES_H_
+#define _HOST_C_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t   uint8;
+typedef int8_t    sint8;
+typedef int8_t    int8;
+typedef uint16_t  uint16;
+typedef int16_t   sint16;
+typedef int16_t   sint16_t;
+typedef uint32_t  uint32;
+typedef int32_t   sint32;
+typedef int32_t   int32;
+typedef uint64_t  uint64;
+typedef int64_t   sint64;
+
+typedef uint8_t   u8;
+typedef int8_t    s8;
+typedef uint16_t  u16;
+typedef int16_t   s16;
+typedef uint32_t  u32;
+typedef int32_t   s32;
+
+typedef enum {
+  OK = 0,
+  FAIL,
+  PENDING,
+  BUSY,
+  CANCEL,
+} STATUS;
+
+#define BIT(nr)                 (1UL << (nr))
+
+#define LOCAL static
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define IRAM_ATTR
+
+#endif
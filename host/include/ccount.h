@@ -0,0 +1,37 @@
+/*
+ * ccount.h - Host stand-in for the Xtensa cycle counter.
+ *
+ * Derived from the monotonic clock, counted at the CPU clock the
+ * firmware has set, so cycle figures read the same as on the target.
+ * CPU time accounting uses the thread CPU clock instead, so time the
+ * host spends on other processes is not charged to the firmware.
+ */
+#ifndef _HOST_CCOUNT_H_
+#define _HOST_CCOUNT_H_
+
+#include <time.h>
+
+#include "c_types.h"
+#include "user_interface.h"
+
+static inline uint32_t
+ccount_read(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) *
+                    system_get_cpu_freq() / 1000);
+}
+
+static inline uint32_t
+ccount_cpu_read(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) *
+                    system_get_cpu_freq() / 1000);
+}
+
+#endif
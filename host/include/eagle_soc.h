@@ -0,0 +1,18 @@
+/*
+ * eagle_soc.h - Host stand-in for the ESP8266 register access macros.
+ *
+ * There are no peripherals on the host. Register reads return 0 and
+ * writes are discarded, which is enough for headers that only define
+ * register layouts.
+ */
+#ifndef _HOST_EAGLE_SOC_H_
+#define _HOST_EAGLE_SOC_H_
+
+#include "c_types.h"
+
+#define READ_PERI_REG(addr)                 (0)
+#define WRITE_PERI_REG(addr, val)           ((void)(addr), (void)(val))
+#define CLEAR_PERI_REG_MASK(reg, mask)      ((void)(reg), (void)(mask))
+#define SET_PERI_REG_MASK(reg, mask)        ((void)(reg), (void)(mask))
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * ets_sys.h - Host stand-in for the ESP8266 SDK event and timer types.
+ */
+#ifndef _HOST_ETS_SYS_H_
+#define _HOST_ETS_SYS_H_
+
+#include "c_types.h"
+#include "eagle_soc.h"
+
+typedef uint32_t ETSSignal;
+typedef uintptr_t ETSParam;
+
+typedef struct ETSEventTag ETSEvent;
+
+struct ETSEventTag {
+  ETSSignal sig;
+  ETSParam  par;
+};
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+typedef void ETSTimerFunc(void *timer_arg);
+
+typedef struct _ETSTIMER_ {
+  struct _ETSTIMER_ *timer_next;
+  uint64_t           timer_expire;   // host: absolute expiry in us
+  uint32_t           timer_period;   // host: period in ms, 0 for one-shot
+  ETSTimerFunc      *timer_func;
+  void              *timer_arg;
+} ETSTimer;
+
+// There are no interrupts on the host, the UART input comes from the loop
+#define ETS_INTR_LOCK()
+#define ETS_INTR_UNLOCK()
+
+#define ETS_UART_INTR_ENABLE()
+#define ETS_UART_INTR_DISABLE()
+#define ETS_UART_INTR_ATTACH(func, arg)
+
+#endif
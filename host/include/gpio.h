@@ -0,0 +1,11 @@
+/*
+ * gpio.h - Host stand-in for the ESP8266 SDK GPIO interface.
+ */
+#ifndef _HOST_GPIO_H_
+#define _HOST_GPIO_H_
+
+#include "c_types.h"
+
+void gpio_init(void);
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * espconn.h - Host stand-in for the SDK espconn API.
+ *
+ * No sockets are opened on the host; espconn_sent() writes to stdout
+ * like the serial console does.
+ */
+#ifndef _HOST_ESPCONN_H_
+#define _HOST_ESPCONN_H_
+
+#include "lwip/ip_addr.h"
+
+enum espconn_type {
+  ESPCONN_INVALID = 0,
+  ESPCONN_TCP     = 0x10,
+  ESPCONN_UDP     = 0x20,
+};
+
+struct espconn {
+  enum espconn_type type;
+  void *reverse;
+};
+
+sint8 espconn_sent(struct espconn *espconn, uint8 *psent, uint16 length);
+sint8 espconn_disconnect(struct espconn *espconn);
+void espconn_dns_setserver(char numdns, ip_addr_t *dnsserver);
+
+#endif
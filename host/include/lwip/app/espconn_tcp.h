@@ -0,0 +1,9 @@
+/*
+ * espconn_tcp.h - Host stand-in, the TCP side of espconn is not used.
+ */
+#ifndef _HOST_ESPCONN_TCP_H_
+#define _HOST_ESPCONN_TCP_H_
+
+#include "lwip/app/espconn.h"
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * def.h - Host stand-in for lwIP's common definitions.
+ */
+#ifndef _HOST_LWIP_DEF_H_
+#define _HOST_LWIP_DEF_H_
+
+#include "lwip/ip_addr.h"
+
+#ifndef LWIP_MIN
+#define LWIP_MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#endif
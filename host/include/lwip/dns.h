@@ -0,0 +1,11 @@
+/*
+ * dns.h - Host stand-in for the lwIP DNS client.
+ */
+#ifndef _HOST_LWIP_DNS_H_
+#define _HOST_LWIP_DNS_H_
+
+#include "lwip/ip_addr.h"
+
+ip_addr_t dns_getserver(u8_t numdns);
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * err.h - Host stand-in for the lwIP error codes.
+ */
+#ifndef _HOST_LWIP_ERR_H_
+#define _HOST_LWIP_ERR_H_
+
+#include "arch/cc.h"
+
+typedef s8_t err_t;
+
+#define ERR_OK          0
+#define ERR_MEM        -1
+#define ERR_BUF        -2
+#define ERR_ARG       -14
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * ip.h - Host stand-in for the lwIP IP layer header.
+ */
+#ifndef _HOST_LWIP_IP_H_
+#define _HOST_LWIP_IP_H_
+
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/ip_addr.h"
+#include "lwip/err.h"
+#include "lwip/netif.h"
+
+#endif
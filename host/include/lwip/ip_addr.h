@@ -0,0 +1,47 @@
+/*
+ * ip_addr.h - Host stand-in for the lwIP IPv4 address helpers.
+ */
+#ifndef _HOST_LWIP_IP_ADDR_H_
+#define _HOST_LWIP_IP_ADDR_H_
+
+#include "arch/cc.h"
+
+struct ip_addr {
+  u32_t addr;
+};
+
+typedef struct ip_addr ip_addr_t;
+
+struct ip_info {
+  struct ip_addr ip;
+  struct ip_addr netmask;
+  struct ip_addr gw;
+};
+
+/* Addresses are kept in network byte order, as on the target */
+#define IP4_ADDR(ipaddr, a, b, c, d) \
+        (ipaddr)->addr = ((u32_t)((d) & 0xff) << 24) | \
+                         ((u32_t)((c) & 0xff) << 16) | \
+                         ((u32_t)((b) & 0xff) << 8)  | \
+                          (u32_t)((a) & 0xff)
+
+#define ip4_addr1(ipaddr) (((u8_t*)(ipaddr))[0])
+#define ip4_addr2(ipaddr) (((u8_t*)(ipaddr))[1])
+#define ip4_addr3(ipaddr) (((u8_t*)(ipaddr))[2])
+#define ip4_addr4(ipaddr) (((u8_t*)(ipaddr))[3])
+
+#define ip4_addr1_16(ipaddr) ((u16_t)ip4_addr1(ipaddr))
+#define ip4_addr2_16(ipaddr) ((u16_t)ip4_addr2(ipaddr))
+#define ip4_addr3_16(ipaddr) ((u16_t)ip4_addr3(ipaddr))
+#define ip4_addr4_16(ipaddr) ((u16_t)ip4_addr4(ipaddr))
+
+#define IP2STR(ipaddr) ip4_addr1_16(ipaddr), \
+    ip4_addr2_16(ipaddr), \
+    ip4_addr3_16(ipaddr), \
+    ip4_addr4_16(ipaddr)
+
+#define IPSTR "%d.%d.%d.%d"
+
+u32_t ipaddr_addr(const char *cp);
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * lwip_napt.h - Host stand-in for the NAPT extension. NAPT itself is
+ * not simulated; the netif napt flag is only stored.
+ */
+#ifndef _HOST_LWIP_NAPT_H_
+#define _HOST_LWIP_NAPT_H_
+
+#include "lwip/ip_addr.h"
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * netif.h - Host stand-in for the lwIP network interface.
+ *
+ * The layout keeps the members the ESPerPass sources touch (input,
+ * linkoutput, ip_addr, num, napt) and drops everything else.
+ */
+#ifndef _HOST_LWIP_NETIF_H_
+#define _HOST_LWIP_NETIF_H_
+
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+#define NETIF_MAX_HWADDR_LEN 6U
+
+struct netif;
+
+typedef err_t (*netif_init_fn)(struct netif *netif);
+typedef err_t (*netif_input_fn)(struct pbuf *p, struct netif *inp);
+typedef err_t (*netif_output_fn)(struct netif *netif, struct pbuf *p,
+       ip_addr_t *ipaddr);
+typedef err_t (*netif_linkoutput_fn)(struct netif *netif, struct pbuf *p);
+
+struct netif {
+  struct netif *next;
+
+  ip_addr_t ip_addr;
+  ip_addr_t netmask;
+  ip_addr_t gw;
+
+  netif_input_fn input;
+  netif_output_fn output;
+  netif_linkoutput_fn linkoutput;
+
+  void *state;
+
+  u16_t mtu;
+  u8_t hwaddr_len;
+  u8_t hwaddr[NETIF_MAX_HWADDR_LEN];
+  u8_t flags;
+  char name[2];
+  u8_t num;
+  u8_t napt;
+};
+
+extern struct netif *netif_list;
+extern struct netif *netif_default;
+
+#endif
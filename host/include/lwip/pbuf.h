@@ -0,0 +1,43 @@
+/*
+ * pbuf.h - Host stand-in for lwIP packet buffers.
+ *
+ * Only PBUF_RAM chains are supported. The allocator lives in
+ * host/lwip.c.
+ */
+#ifndef _HOST_LWIP_PBUF_H_
+#define _HOST_LWIP_PBUF_H_
+
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+typedef enum {
+  PBUF_TRANSPORT,
+  PBUF_IP,
+  PBUF_LINK,
+  PBUF_RAW
+} pbuf_layer;
+
+typedef enum {
+  PBUF_RAM,
+  PBUF_ROM,
+  PBUF_REF,
+  PBUF_POOL,
+  PBUF_ESF_RX
+} pbuf_type;
+
+struct pbuf {
+  struct pbuf *next;
+  void *payload;
+  u16_t tot_len;
+  u16_t len;
+  u8_t type;
+  u8_t flags;
+  u16_t ref;
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_ref(struct pbuf *p);
+void pbuf_cat(struct pbuf *head, struct pbuf *tail);
+
+#endif
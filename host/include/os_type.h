@@ -0,0 +1,16 @@
+/*
+ * os_type.h - Host stand-in for the ESP8266 SDK os_* type aliases.
+ */
+#ifndef _HOST_OS_TYPE_H_
+#define _HOST_OS_TYPE_H_
+
+#include "ets_sys.h"
+
+#define os_signal_t ETSSignal
+#define os_param_t ETSParam
+#define os_event_t ETSEvent
+#define os_task_t ETSTask
+#define os_timer_t ETSTimer
+#define os_timer_func_t ETSTimerFunc
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * osapi.h - Host stand-in for the ESP8266 SDK os_* helpers.
+ */
+#ifndef _HOST_OSAPI_H_
+#define _HOST_OSAPI_H_
+
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "os_type.h"
+#include "user_interface.h"
+
+#define os_memcmp memcmp
+#define os_memcpy memcpy
+#define os_memmove memmove
+#define os_memset memset
+#define os_strcat strcat
+#define os_strchr strchr
+#define os_strcmp strcmp
+#define os_strcpy strcpy
+#define os_strlen strlen
+#define os_strncmp strncmp
+#define os_strncpy strncpy
+#define os_strstr strstr
+#define os_sprintf sprintf
+#define os_snprintf snprintf
+
+int os_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+void os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg);
+void os_timer_arm(os_timer_t *ptimer, uint32_t msec, bool repeat_flag);
+void os_timer_disarm(os_timer_t *ptimer);
+
+// ROM helper, returns non-zero on success
+int ets_str2macaddr(uint8 *mac, char *str_mac);
+
+// ROM printf, hands the output to print_function one character at a time
+int ets_vprintf(int (*print_function)(int), const char *format, va_list arg);
+
+#endif
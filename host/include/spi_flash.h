@@ -0,0 +1,25 @@
+/*
+ * spi_flash.h - Host stand-in for the ESP8266 SDK SPI flash interface.
+ *
+ * The host implementation keeps the flash image in a file (see
+ * host/sdk.c) and emulates NOR semantics: erase sets a sector to 0xff
+ * and writes can only clear bits.
+ */
+#ifndef _HOST_SPI_FLASH_H_
+#define _HOST_SPI_FLASH_H_
+
+#include "c_types.h"
+
+typedef enum {
+  SPI_FLASH_RESULT_OK,
+  SPI_FLASH_RESULT_ERR,
+  SPI_FLASH_RESULT_TIMEOUT
+} SpiFlashOpResult;
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec);
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size);
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * lwip.c - Host stand-ins for the few lwIP functions the user code and
+ * the harness use.
+ */
+#include <arpa/inet.h>
+
+#include "c_types.h"
+#include "mem.h"
+#include "osapi.h"
+#include "lwip/ip.h"
+#include "lwip/dns.h"
+
+struct netif *netif_list;
+struct netif *netif_default;
+
+u32_t
+ipaddr_addr(const char *cp)
+{
+  struct in_addr a;
+
+  if (inet_aton(cp, &a) == 0)
+  {
+    return 0xffffffffUL;
+  }
+  return a.s_addr;
+}
+
+ip_addr_t
+dns_getserver(u8_t numdns)
+{
+  ip_addr_t ip;
+
+  IP4_ADDR(&ip, 8, 8, 8, 8);
+  return ip;
+}
+
+/*
+ * Only PBUF_RAM pbufs are provided: header and payload in a single
+ * allocation, a chain is built with pbuf_cat().
+ */
+struct pbuf *
+pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type)
+{
+  struct pbuf *p = os_malloc(sizeof(struct pbuf) + length);
+
+  if (p == NULL)
+  {
+    return NULL;
+  }
+  p->next = NULL;
+  p->payload = (u8_t *)p + sizeof(struct pbuf);
+  p->tot_len = p->len = length;
+  p->type = PBUF_RAM;
+  p->flags = 0;
+  p->ref = 1;
+  return p;
+}
+
+u8_t
+pbuf_free(struct pbuf *p)
+{
+  u8_t count = 0;
+
+  while (p != NULL && --p->ref == 0)
+  {
+    struct pbuf *q = p->next;
+
+    os_free(p);
+    count++;
+    p = q;
+  }
+  return count;
+}
+
+void
+pbuf_ref(struct pbuf *p)
+{
+  if (p != NULL)
+  {
+    p->ref++;
+  }
+}
+
+void
+pbuf_cat(struct pbuf *head, struct pbuf *tail)
+{
+  struct pbuf *p;
+
+  for (p = head; p->next != NULL; p = p->next)
+  {
+    p->tot_len += tail->tot_len;
+  }
+  p->tot_len += tail->tot_len;
+  p->next = tail;
+}
@@ -0,0 +1,132 @@
+/*
+ * main.c - Entry point of the host-native build.
+ *
+ * Runs user_init() and then plays the part of the SDK main loop: expired
+ * timers fire, posted task events are dispatched and stdin is fed to the
+ * console as UART input, a line at a time or, with -p, as it is read.
+ * The loop ends when stdin closes, or after the number of seconds given
+ * with -t.
+ */
+#include <poll.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "osapi.h"
+
+#include "host.h"
+
+void user_init(void);
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-f flash.bin] [-t seconds] [-p]\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * Hand input to the console one line at a time and let the task run in
+ * between, the way it sees a human typing rather than a pasted block.
+ */
+static void
+feed_lines(const char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    const char *eol = memchr(buf, '\n', len);
+    size_t n = eol != NULL ? (size_t)(eol - buf) + 1 : len;
+
+    host_uart_rx(buf, n);
+    host_run_tasks();
+    buf += n;
+    len -= n;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *flash_file = "flash.bin";
+  uint64_t run_until = 0;
+  bool stdin_open = true;
+  bool paste = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:pt:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        flash_file = optarg;
+        break;
+      case 'p':
+        paste = true;
+        break;
+      case 't':
+        run_until = (uint64_t)atoi(optarg) * 1000000;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  host_init(flash_file, argv);
+  host_wifi_init();
+  user_init();
+  host_init_done();
+
+  for (;;)
+  {
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    int64_t timeout = host_next_timer_us();
+    char buf[256];
+    ssize_t n;
+
+    host_run_timers();
+    host_run_tasks();
+    fflush(stdout);
+
+    if (run_until != 0 && host_time_us() >= run_until)
+    {
+      break;
+    }
+    if (!stdin_open && run_until == 0)
+    {
+      break;
+    }
+
+    timeout = host_next_timer_us();
+    if (run_until != 0 && (timeout < 0 ||
+                           host_time_us() + timeout > run_until))
+    {
+      timeout = run_until - host_time_us();
+    }
+
+    if (!stdin_open)
+    {
+      usleep(timeout);
+      continue;
+    }
+
+    if (poll(&pfd, 1, timeout < 0 ? -1 : (int)((timeout + 999) / 1000)) > 0)
+    {
+      n = read(STDIN_FILENO, buf, sizeof(buf));
+      if (n <= 0)
+      {
+        stdin_open = false;
+        continue;
+      }
+      if (paste)
+      {
+        host_uart_rx(buf, n);
+      }
+      else
+      {
+        feed_lines(buf, n);
+      }
+    }
+  }
+
+  fflush(stdout);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * ringbuf_legacy.c - The "one byte wasted" ring buffer that user/ringbuf.c
+ * used before the power-of-two rewrite, kept as the reference point for
+ * bench_ringbuf. Only the functions the benchmark needs are here, with a
+ * legacy_ prefix. Originally written in 2011 by Drew Hess
+ * <dhess-src@bothan.net>, CC0.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "mem.h"
+#include "osapi.h"
+
+#include "ringbuf_legacy.h"
+
+struct legacy_ringbuf_t
+{
+    uint8_t *buf;
+    uint8_t *head, *tail;
+    size_t size;
+};
+
+legacy_ringbuf_t
+legacy_ringbuf_new(size_t capacity)
+{
+    legacy_ringbuf_t rb = os_malloc(sizeof(struct legacy_ringbuf_t));
+    if (rb) {
+        /* One byte is used for detecting the full condition. */
+        rb->size = capacity + 1;
+        rb->buf = os_malloc(rb->size);
+        rb->head = rb->tail = rb->buf;
+    }
+    return rb;
+}
+
+void
+legacy_ringbuf_free(legacy_ringbuf_t rb)
+{
+    os_free(rb->buf);
+    os_free(rb);
+}
+
+static size_t
+legacy_ringbuf_capacity(const struct legacy_ringbuf_t *rb)
+{
+    return rb->size - 1;
+}
+
+static const uint8_t *
+legacy_ringbuf_end(const struct legacy_ringbuf_t *rb)
+{
+    return rb->buf + rb->size;
+}
+
+size_t
+legacy_ringbuf_bytes_free(const struct legacy_ringbuf_t *rb)
+{
+    if (rb->head >= rb->tail)
+        return legacy_ringbuf_capacity(rb) - (rb->head - rb->tail);
+    else
+        return rb->tail - rb->head - 1;
+}
+
+size_t
+legacy_ringbuf_bytes_used(const struct legacy_ringbuf_t *rb)
+{
+    return legacy_ringbuf_capacity(rb) - legacy_ringbuf_bytes_free(rb);
+}
+
+static uint8_t *
+legacy_ringbuf_nextp(legacy_ringbuf_t rb, const uint8_t *p)
+{
+    return rb->buf + ((++p - rb->buf) % rb->size);
+}
+
+void *
+legacy_ringbuf_memcpy_into(legacy_ringbuf_t dst, const void *src, size_t count)
+{
+    const uint8_t *u8src = src;
+    const uint8_t *bufend = legacy_ringbuf_end(dst);
+    int overflow = count > legacy_ringbuf_bytes_free(dst);
+    size_t nread = 0;
+
+    while (nread != count) {
+        size_t n = MIN(bufend - dst->head, count - nread);
+        os_memcpy(dst->head, u8src + nread, n);
+        dst->head += n;
+        nread += n;
+
+        if (dst->head == bufend)
+            dst->head = dst->buf;
+    }
+
+    if (overflow)
+        dst->tail = legacy_ringbuf_nextp(dst, dst->head);
+
+    return dst->head;
+}
+
+void *
+legacy_ringbuf_memcpy_from(void *dst, legacy_ringbuf_t src, size_t count)
+{
+    size_t bytes_used = legacy_ringbuf_bytes_used(src);
+    if (count > bytes_used)
+        return 0;
+
+    uint8_t *u8dst = dst;
+    const uint8_t *bufend = legacy_ringbuf_end(src);
+    size_t nwritten = 0;
+    while (nwritten != count) {
+        size_t n = MIN(bufend - src->tail, count - nwritten);
+        os_memcpy(u8dst + nwritten, src->tail, n);
+        src->tail += n;
+        nwritten += n;
+
+        if (src->tail == bufend)
+            src->tail = src->buf;
+    }
+
+    return src->tail;
+}
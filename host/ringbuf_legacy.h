@@ -0,0 +1,19 @@
+/*
+ * ringbuf_legacy.h - Interface of the pre power-of-two ring buffer, see
+ * ringbuf_legacy.c.
+ */
+#ifndef _HOST_RINGBUF_LEGACY_H_
+#define _HOST_RINGBUF_LEGACY_H_
+
+#include <stddef.h>
+
+typedef struct legacy_ringbuf_t *legacy_ringbuf_t;
+
+legacy_ringbuf_t legacy_ringbuf_new(size_t capacity);
+void legacy_ringbuf_free(legacy_ringbuf_t rb);
+size_t legacy_ringbuf_bytes_free(const struct legacy_ringbuf_t *rb);
+size_t legacy_ringbuf_bytes_used(const struct legacy_ringbuf_t *rb);
+void *legacy_ringbuf_memcpy_into(legacy_ringbuf_t dst, const void *src, size_t count);
+void *legacy_ringbuf_memcpy_from(void *dst, legacy_ringbuf_t src, size_t count);
+
+#endif
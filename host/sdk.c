@@ -0,0 +1,485 @@
+/*
+ * sdk.c - Host stand-ins for the ESP8266 SDK system services.
+ *
+ * Timers are kept in a list ordered by expiry and are run from the main
+ * loop, task queues are plain arrays with the length handed to
+ * system_os_task(), flash is a file with NOR semantics and RTC memory
+ * is kept across system_restart().
+ */
+#include <fcntl.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "mem.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "spi_flash.h"
+
+#include "host.h"
+
+#define HOST_FLASH_SIZE   (4 * 1024 * 1024)
+#define HOST_RTC_MEM_SIZE 768
+// Carries the RTC memory over the exec() of a restart
+#define HOST_RTC_ENV      "ESPERPASS_HOST_RTC"
+#define HOST_TASK_PRIOS   3
+
+static uint64_t time_base;
+static int flash_fd = -1;
+static char **host_argv;
+static uint8 os_print = 1;
+static uint8 cpu_freq = 80;
+static init_done_cb_t init_done_cb;
+static uint32 rtc_mem[HOST_RTC_MEM_SIZE / 4];
+
+static os_timer_t *timer_list;
+
+static struct
+{
+  os_task_t task;
+  os_event_t *queue;
+  uint8 qlen;
+  uint8 head;
+  uint8 count;
+} tasks[HOST_TASK_PRIOS];
+
+uint64_t
+host_time_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - time_base;
+}
+
+/*
+ * Fills the image up to the full flash size with 0xff, so all of it
+ * reads as erased. Holes in a sparse file would read as 0x00.
+ */
+static void
+host_flash_fill(void)
+{
+  uint8_t buf[SPI_FLASH_SEC_SIZE];
+  off_t size = lseek(flash_fd, 0, SEEK_END);
+  size_t n;
+
+  os_memset(buf, 0xff, sizeof(buf));
+  while (size >= 0 && size < HOST_FLASH_SIZE)
+  {
+    n = sizeof(buf) - size % sizeof(buf);
+    if (pwrite(flash_fd, buf, n, size) != (ssize_t)n)
+    {
+      perror("flash image");
+      exit(EXIT_FAILURE);
+    }
+    size += n;
+  }
+}
+
+void
+host_init(const char *flash_file, char **argv)
+{
+  const char *rtc;
+  size_t i;
+
+  time_base = 0;
+  time_base = host_time_us();
+  host_argv = argv;
+
+  // RTC memory survives a restart, see system_restart()
+  rtc = getenv(HOST_RTC_ENV);
+  if (rtc != NULL && strlen(rtc) == 2 * sizeof(rtc_mem))
+  {
+    for (i = 0; i < sizeof(rtc_mem); i++)
+    {
+      sscanf(rtc + 2 * i, "%2hhx", (uint8_t *)rtc_mem + i);
+    }
+  }
+  unsetenv(HOST_RTC_ENV);
+
+  flash_fd = open(flash_file, O_RDWR | O_CREAT, 0644);
+  if (flash_fd < 0)
+  {
+    perror(flash_file);
+    exit(EXIT_FAILURE);
+  }
+  host_flash_fill();
+}
+
+/*
+ * System
+ */
+void
+system_restart(void)
+{
+  char rtc[2 * sizeof(rtc_mem) + 1];
+  size_t i;
+
+  os_printf("system_restart\r\n");
+  fflush(stdout);
+  if (host_argv != NULL)
+  {
+    for (i = 0; i < sizeof(rtc_mem); i++)
+    {
+      sprintf(rtc + 2 * i, "%02x", ((uint8_t *)rtc_mem)[i]);
+    }
+    setenv(HOST_RTC_ENV, rtc, 1);
+    execv("/proc/self/exe", host_argv);
+  }
+  exit(EXIT_SUCCESS);
+}
+
+void
+system_init_done_cb(init_done_cb_t cb)
+{
+  init_done_cb = cb;
+}
+
+void
+host_init_done(void)
+{
+  if (init_done_cb != NULL)
+  {
+    init_done_cb();
+  }
+}
+
+uint32
+system_get_time(void)
+{
+  return (uint32)host_time_us();
+}
+
+uint32
+system_get_rtc_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint32)(ts.tv_sec ^ ts.tv_nsec);
+}
+
+uint32
+system_get_free_heap_size(void)
+{
+  return 40 * 1024;
+}
+
+void
+system_set_os_print(uint8 onoff)
+{
+  os_print = onoff;
+}
+
+bool
+system_update_cpu_freq(uint8 freq)
+{
+  if (freq != 80 && freq != 160)
+  {
+    return false;
+  }
+  cpu_freq = freq;
+  return true;
+}
+
+uint8
+system_get_cpu_freq(void)
+{
+  return cpu_freq;
+}
+
+bool
+system_rtc_mem_read(uint8 src_addr, void *des_addr, uint16 load_size)
+{
+  if (src_addr < 64 || src_addr * 4 + load_size > sizeof(rtc_mem))
+  {
+    return false;
+  }
+  os_memcpy(des_addr, &rtc_mem[src_addr], load_size);
+  return true;
+}
+
+bool
+system_rtc_mem_write(uint8 des_addr, const void *src_addr, uint16 save_size)
+{
+  if (des_addr < 64 || des_addr * 4 + save_size > sizeof(rtc_mem))
+  {
+    return false;
+  }
+  os_memcpy(&rtc_mem[des_addr], src_addr, save_size);
+  return true;
+}
+
+int
+os_printf(const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  if (!os_print)
+  {
+    return 0;
+  }
+  va_start(ap, fmt);
+  n = vprintf(fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+int
+ets_vprintf(int (*print_function)(int), const char *format, va_list arg)
+{
+  char buf[1024];
+  int n, i;
+
+  n = vsnprintf(buf, sizeof(buf), format, arg);
+  for (i = 0; i < n && i < (int)sizeof(buf) - 1; i++)
+  {
+    print_function((unsigned char)buf[i]);
+  }
+  return n;
+}
+
+int
+ets_str2macaddr(uint8 *mac, char *str_mac)
+{
+  unsigned int m[6];
+  int i;
+
+  if (sscanf(str_mac, "%2x:%2x:%2x:%2x:%2x:%2x",
+             &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+  {
+    return 0;
+  }
+  for (i = 0; i < 6; i++)
+  {
+    mac[i] = m[i];
+  }
+  return 1;
+}
+
+/*
+ * Timers
+ */
+void
+os_timer_disarm(os_timer_t *ptimer)
+{
+  os_timer_t **pp;
+
+  for (pp = &timer_list; *pp != NULL; pp = &(*pp)->timer_next)
+  {
+    if (*pp == ptimer)
+    {
+      *pp = ptimer->timer_next;
+      break;
+    }
+  }
+  ptimer->timer_next = NULL;
+}
+
+void
+os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg)
+{
+  os_timer_disarm(ptimer);
+  ptimer->timer_func = pfunction;
+  ptimer->timer_arg = parg;
+}
+
+static void
+timer_insert(os_timer_t *ptimer)
+{
+  os_timer_t **pp;
+
+  for (pp = &timer_list;
+       *pp != NULL && (*pp)->timer_expire <= ptimer->timer_expire;
+       pp = &(*pp)->timer_next);
+  ptimer->timer_next = *pp;
+  *pp = ptimer;
+}
+
+void
+os_timer_arm(os_timer_t *ptimer, uint32_t msec, bool repeat_flag)
+{
+  os_timer_disarm(ptimer);
+  ptimer->timer_expire = host_time_us() + (uint64_t)msec * 1000;
+  ptimer->timer_period = repeat_flag ? msec : 0;
+  timer_insert(ptimer);
+}
+
+int
+host_run_timers(void)
+{
+  uint64_t now = host_time_us();
+  int n = 0;
+
+  while (timer_list != NULL && timer_list->timer_expire <= now)
+  {
+    os_timer_t *t = timer_list;
+
+    timer_list = t->timer_next;
+    t->timer_next = NULL;
+    if (t->timer_period != 0)
+    {
+      t->timer_expire += (uint64_t)t->timer_period * 1000;
+      timer_insert(t);
+    }
+    t->timer_func(t->timer_arg);
+    n++;
+  }
+  return n;
+}
+
+int64_t
+host_next_timer_us(void)
+{
+  uint64_t now;
+
+  if (timer_list == NULL)
+  {
+    return -1;
+  }
+  now = host_time_us();
+  return timer_list->timer_expire > now ? timer_list->timer_expire - now : 0;
+}
+
+/*
+ * Tasks
+ */
+bool
+system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen)
+{
+  if (prio >= HOST_TASK_PRIOS || qlen == 0)
+  {
+    return false;
+  }
+  tasks[prio].task = task;
+  tasks[prio].queue = queue;
+  tasks[prio].qlen = qlen;
+  tasks[prio].head = tasks[prio].count = 0;
+  return true;
+}
+
+bool
+system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
+{
+  os_event_t *e;
+
+  if (prio >= HOST_TASK_PRIOS || tasks[prio].queue == NULL ||
+      tasks[prio].count == tasks[prio].qlen)
+  {
+    return false;
+  }
+  e = &tasks[prio].queue[(tasks[prio].head + tasks[prio].count) %
+                         tasks[prio].qlen];
+  e->sig = sig;
+  e->par = par;
+  tasks[prio].count++;
+  return true;
+}
+
+int
+host_run_tasks(void)
+{
+  int prio, n = 0;
+  bool ran;
+
+  // Highest priority first; the event is dequeued before the task runs
+  do
+  {
+    ran = false;
+    for (prio = HOST_TASK_PRIOS - 1; prio >= 0 && !ran; prio--)
+    {
+      os_event_t e;
+
+      if (tasks[prio].count == 0)
+      {
+        continue;
+      }
+      e = tasks[prio].queue[tasks[prio].head];
+      tasks[prio].head = (tasks[prio].head + 1) % tasks[prio].qlen;
+      tasks[prio].count--;
+      tasks[prio].task(&e);
+      ran = true;
+      n++;
+    }
+  } while (ran);
+  return n;
+}
+
+/*
+ * Flash
+ */
+int32_t host_flash_write_budget = -1;
+
+SpiFlashOpResult
+spi_flash_erase_sector(uint16 sec)
+{
+  uint8_t buf[SPI_FLASH_SEC_SIZE];
+
+  if ((uint32_t)(sec + 1) * SPI_FLASH_SEC_SIZE > HOST_FLASH_SIZE)
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  os_memset(buf, 0xff, sizeof(buf));
+  if (pwrite(flash_fd, buf, sizeof(buf),
+             (off_t)sec * SPI_FLASH_SEC_SIZE) != sizeof(buf))
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult
+spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size)
+{
+  ssize_t n;
+
+  if ((src_addr & 3) || src_addr + size > HOST_FLASH_SIZE)
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  // host_init() has filled the whole image, erased or not
+  n = pread(flash_fd, des_addr, size, src_addr);
+  if (n != (ssize_t)size)
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult
+spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size)
+{
+  uint8_t *buf;
+  uint32 i, cut = 0;
+
+  if ((des_addr & 3) || des_addr + size > HOST_FLASH_SIZE)
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  if (host_flash_write_budget >= 0 && size > (uint32)host_flash_write_budget)
+  {
+    // Power loss: only the first bytes make it
+    cut = size - host_flash_write_budget;
+    size = host_flash_write_budget;
+  }
+  if (host_flash_write_budget >= 0)
+  {
+    host_flash_write_budget -= size;
+  }
+  buf = os_malloc(size);
+  spi_flash_read(des_addr, (uint32 *)buf, size);
+  // NOR flash can only clear bits
+  for (i = 0; i < size; i++)
+  {
+    buf[i] &= ((uint8_t *)src_addr)[i];
+  }
+  if (pwrite(flash_fd, buf, size, des_addr) != (ssize_t)size)
+  {
+    os_free(buf);
+    return SPI_FLASH_RESULT_ERR;
+  }
+  os_free(buf);
+  return cut != 0 ? SPI_FLASH_RESULT_ERR : SPI_FLASH_RESULT_OK;
+}
@@ -0,0 +1,103 @@
+/*
+ * sim_mac_bag.c - How well the StreetPass MAC selection covers the list
+ * over many AP cycles.
+ *
+ * "bag" is mac_bag_next() as the firmware calls it once per cycle, with
+ * the host RTC memory kept between calls the way a restart keeps it.
+ * "rand" is the selection it replaced, (rand() % 96) / 6 after an
+ * srand(), given an independent seed every cycle; that is the best case
+ * for it, the RTC time it was seeded with on the chip is far less random.
+ *
+ *   make -C host sim && ../build/host/sim_mac_bag [-n cycles]
+ */
+#include <unistd.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "config_flash.h"
+#include "mac_bag.h"
+
+static uint32_t seed = 0x2545f491;
+
+static uint8_t
+select_bag(void)
+{
+  return mac_bag_next(MAC_LIST_LENGTH);
+}
+
+static uint8_t
+select_rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  srand(seed);
+  return rand() % (MAC_LIST_LENGTH * 6) / 6;
+}
+
+static void
+simulate(const char *name, uint8_t (*next)(void), uint32_t cycles)
+{
+  uint32_t last_used[MAC_LIST_LENGTH];
+  uint32_t uses[MAC_LIST_LENGTH];
+  uint32_t i, distinct = 0, full = 0, repeats = 0, max_gap = 0;
+  uint32_t min_uses = 0xffffffff, max_uses = 0;
+  int last = -1;
+
+  os_memset(last_used, 0, sizeof(last_used));
+  os_memset(uses, 0, sizeof(uses));
+
+  for (i = 1; i <= cycles; i++)
+  {
+    uint8_t mac = next();
+
+    if (uses[mac]++ == 0)
+    {
+      if (++distinct == MAC_LIST_LENGTH)
+      {
+        full = i;
+      }
+    }
+    else if (i - last_used[mac] > max_gap)
+    {
+      max_gap = i - last_used[mac];
+    }
+    if (mac == last)
+    {
+      repeats++;
+    }
+    last_used[mac] = i;
+    last = mac;
+  }
+
+  for (i = 0; i < MAC_LIST_LENGTH; i++)
+  {
+    min_uses = uses[i] < min_uses ? uses[i] : min_uses;
+    max_uses = uses[i] > max_uses ? uses[i] : max_uses;
+  }
+
+  printf("%-4s %8u %8u/%u %10u %8u %8u %6u-%u\n", name, cycles, distinct,
+         MAC_LIST_LENGTH, full, repeats, max_gap, min_uses, max_uses);
+}
+
+int
+main(int argc, char **argv)
+{
+  uint32_t cycles = 16 * 1000;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1)
+  {
+    if (opt != 'n')
+    {
+      fprintf(stderr, "usage: %s [-n cycles]\n", argv[0]);
+      return 1;
+    }
+    cycles = atoi(optarg);
+  }
+
+  printf("sel    cycles  distinct   all seen  repeats  max gap   uses\n");
+  simulate("bag", select_bag, MAC_LIST_LENGTH);
+  simulate("rand", select_rand, MAC_LIST_LENGTH);
+  simulate("bag", select_bag, cycles);
+  simulate("rand", select_rand, cycles);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * stress_spsc.c - Two-thread stress run of ringbuf_spsc_put/get.
+ *
+ * A producer thread plays the UART RX interrupt and pushes a running
+ * byte sequence in random sized pieces (mostly single bytes), a consumer
+ * thread plays user_procTask and drains it in random sized pieces. The
+ * consumer checks that every byte arrives exactly once and in order.
+ * Both yield when the ring is full or empty, so it also makes progress
+ * on a single core. Exits non-zero on the first mismatch.
+ *
+ *   make -C host stress && ../build/host/stress_spsc [-n bytes]
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "ringbuf.h"
+
+static ringbuf_t rb;
+static uint32_t total = 10000000;
+
+static uint32_t
+xorshift(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void *
+producer(void *arg)
+{
+  uint32_t seed = 0x12345678, sent = 0;
+  uint8_t chunk[32];
+
+  while (sent < total)
+  {
+    uint32_t r = xorshift(&seed);
+    size_t n = (r & 3) ? 1 : 1 + (r >> 8) % sizeof(chunk);
+    size_t i;
+
+    if (n > total - sent)
+    {
+      n = total - sent;
+    }
+    for (i = 0; i < n; i++)
+    {
+      chunk[i] = (uint8_t)(sent + i);
+    }
+    n = ringbuf_spsc_put(rb, chunk, n);
+    if (n == 0)
+    {
+      sched_yield();
+    }
+    sent += n;
+  }
+  return NULL;
+}
+
+static void *
+consumer(void *arg)
+{
+  uint32_t seed = 0x9abcdef0, received = 0;
+  uint8_t chunk[96];
+
+  while (received < total)
+  {
+    size_t n = 1 + xorshift(&seed) % sizeof(chunk);
+    size_t got = ringbuf_spsc_get(chunk, rb, n);
+    size_t i;
+
+    for (i = 0; i < got; i++)
+    {
+      if (chunk[i] != (uint8_t)(received + i))
+      {
+        fprintf(stderr, "mismatch at byte %u: got %u, expected %u\n",
+                received + (uint32_t)i, chunk[i],
+                (uint8_t)(received + i));
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (got == 0)
+    {
+      sched_yield();
+    }
+    received += got;
+  }
+  return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const size_t capacities[] = { 80, 250 };
+  int i, opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1)
+  {
+    if (opt != 'n')
+    {
+      fprintf(stderr, "usage: %s [-n bytes]\n", argv[0]);
+      return 1;
+    }
+    total = atoi(optarg);
+  }
+
+  for (i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++)
+  {
+    pthread_t p, c;
+
+    rb = ringbuf_new(capacities[i]);
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    ringbuf_free(&rb);
+    printf("capacity %3u: %u bytes in order\n", (unsigned)capacities[i],
+           total);
+  }
+  return 0;
+}
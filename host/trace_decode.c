@@ -0,0 +1,222 @@
+/*
+ * trace_decode.c - Turns the output of "show trace" into a timeline.
+ *
+ * Reads a console log from stdin and picks out the trace records, so the
+ * pages of several "show trace" commands can simply be appended; records
+ * seen twice are printed once. Times are unwrapped from the 32 bit
+ * system_get_time() and printed relative to the first record. At the end
+ * come the intervals worth watching over a cycle: association and DHCP
+ * of the uplink, and how long the AP was down for each MAC rotation.
+ *
+ *   ../build/host/trace_decode < console.log
+ */
+#include "c_types.h"
+#include "osapi.h"
+#include "lwip/ip_addr.h"
+#include "trace.h"
+
+typedef struct
+{
+  uint32_t seq;
+  trace_rec_t rec;
+} trace_line_t;
+
+typedef struct
+{
+  const char *name;
+  uint32_t count;
+  uint64_t sum, max;
+} interval_t;
+
+static int
+compare_seq(const void *a, const void *b)
+{
+  const trace_line_t *la = a, *lb = b;
+
+  return la->seq < lb->seq ? -1 : la->seq > lb->seq;
+}
+
+static void
+interval_add(interval_t *iv, uint64_t start, uint64_t end)
+{
+  uint64_t us = end - start;
+
+  iv->count++;
+  iv->sum += us;
+  if (us > iv->max)
+  {
+    iv->max = us;
+  }
+  printf("      (%s %llu ms)\n", iv->name, (unsigned long long)(us / 1000));
+}
+
+static void
+interval_print(const interval_t *iv)
+{
+  if (iv->count > 0)
+  {
+    printf("%-22s %4u times, avg %6llu ms, max %6llu ms\n", iv->name,
+           iv->count, (unsigned long long)(iv->sum / iv->count / 1000),
+           (unsigned long long)(iv->max / 1000));
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  trace_line_t *lines = NULL;
+  size_t n = 0, size = 0, i, kept = 0;
+  char buf[256];
+  interval_t assoc = {"STA association"}, dhcp = {"STA DHCP"};
+  interval_t ap_down = {"AP down per rotation"}, ap_off = {"AP off"};
+  uint64_t t = 0, t0 = 0, sta_down = 0, sta_conn = 0, rotate = 0, off = 0;
+  uint32_t last_time = 0;
+
+  if (argc > 1)
+  {
+    fprintf(stderr, "usage: %s < console.log\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  while (fgets(buf, sizeof(buf), stdin) != NULL)
+  {
+    trace_line_t line;
+    unsigned seq, time, event, arg0, arg1;
+    char *rec = strstr(buf, "T ");
+
+    if (rec == NULL ||
+        sscanf(rec, "T %u %x %u %u %x", &seq, &time, &event, &arg0, &arg1) != 5)
+    {
+      continue;
+    }
+    line.seq = seq;
+    line.rec.time = time;
+    line.rec.event = event;
+    line.rec.arg0 = arg0;
+    line.rec.arg1 = arg1;
+    if (n == size)
+    {
+      size = size ? 2 * size : 256;
+      lines = realloc(lines, size * sizeof(*lines));
+    }
+    lines[n++] = line;
+  }
+
+  qsort(lines, n, sizeof(*lines), compare_seq);
+
+  for (i = 0; i < n; i++)
+  {
+    const trace_rec_t *rec = &lines[i].rec;
+
+    if (kept > 0 && lines[i].seq == lines[kept - 1].seq)
+    {
+      continue;
+    }
+    if (kept > 0 && lines[i].seq != lines[kept - 1].seq + 1)
+    {
+      printf("--- %u records missing\n",
+             lines[i].seq - lines[kept - 1].seq - 1);
+    }
+    lines[kept++] = lines[i];
+
+    // The time wraps every 71 minutes, records are never that far apart
+    if (kept == 1)
+    {
+      t0 = t = rec->time;
+    }
+    else
+    {
+      t += (uint32_t)(rec->time - last_time);
+    }
+    last_time = rec->time;
+
+    printf("%10.3f  %-16s", (t - t0) / 1e6,
+           rec->event < TRACE_EVENTS ? trace_event_name[rec->event] : "?");
+    switch (rec->event)
+    {
+      case TRACE_BOOT:
+        // The uplink association is timed from here
+        sta_down = t;
+        break;
+      case TRACE_STA_CONNECTED:
+        printf(" channel %u", rec->arg0);
+        break;
+      case TRACE_STA_DISCONNECTED:
+        printf(" reason %u", rec->arg0);
+        break;
+      case TRACE_STA_GOT_IP:
+        printf(" " IPSTR, IP2STR((ip_addr_t *)&rec->arg1));
+        break;
+      case TRACE_AP_STA_JOIN:
+      case TRACE_AP_STA_LEAVE:
+        printf(" AID %u, MAC ..:%02x:%02x:%02x:%02x", rec->arg0,
+               rec->arg1 >> 24, (rec->arg1 >> 16) & 0xff,
+               (rec->arg1 >> 8) & 0xff, rec->arg1 & 0xff);
+        break;
+      case TRACE_MAC_ROTATE:
+        printf(" to MAC %u%s", rec->arg0, rec->arg1 ? ", new window" : "");
+        break;
+      case TRACE_AP_ON:
+        printf(" MAC %u", rec->arg0);
+        break;
+      case TRACE_WATCHDOG:
+        printf(" %s expired after %u s, restarted",
+               rec->arg0 ? "client" : "AP", rec->arg1);
+        break;
+    }
+    printf("\n");
+
+    switch (rec->event)
+    {
+      case TRACE_STA_CONNECTED:
+        if (sta_down)
+        {
+          interval_add(&assoc, sta_down, t);
+          sta_down = 0;
+        }
+        sta_conn = t;
+        break;
+      case TRACE_STA_DISCONNECTED:
+        if (!sta_down)
+        {
+          sta_down = t;
+        }
+        sta_conn = 0;
+        break;
+      case TRACE_STA_GOT_IP:
+        if (sta_conn)
+        {
+          interval_add(&dhcp, sta_conn, t);
+          sta_conn = 0;
+        }
+        break;
+      case TRACE_MAC_ROTATE:
+        rotate = t;
+        break;
+      case TRACE_AP_ON:
+        if (rotate)
+        {
+          interval_add(&ap_down, rotate, t);
+          rotate = 0;
+        }
+        if (off)
+        {
+          interval_add(&ap_off, off, t);
+          off = 0;
+        }
+        break;
+      case TRACE_AP_OFF:
+        off = t;
+        break;
+    }
+  }
+
+  printf("\n%zu records\n", kept);
+  interval_print(&assoc);
+  interval_print(&dhcp);
+  interval_print(&ap_down);
+  interval_print(&ap_off);
+
+  free(lines);
+  return 0;
+}
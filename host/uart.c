@@ -0,0 +1,78 @@
+/*
+ * uart.c - Host stand-in for the console UART driver.
+ *
+ * Output goes to stdout. Input is handed to host_uart_rx(), which does
+ * what uart0_rx_intr_handler() does with each burst unloaded from the
+ * RX FIFO.
+ */
+#include "c_types.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "driver/uart.h"
+#include "user_config.h"
+
+#include "host.h"
+#include "cpu_stats.h"
+#include "task_post.h"
+
+static ringbuf_t rxBuff;
+static ringbuf_t txBuff;
+
+void
+UART_init_console(UartBautRate uart0_br,
+                  uint8 recv_task_priority,
+                  ringbuf_t rxbuffer,
+                  ringbuf_t txBuffer)
+{
+  rxBuff = rxbuffer;
+  txBuff = txBuffer;
+}
+
+int
+UART_Send(uint8 uart_no, char *buffer, int len)
+{
+  fwrite(buffer, 1, len, stdout);
+  return len;
+}
+
+STATUS
+uart_tx_one_char(uint8 uart, uint8 TxChar)
+{
+  putchar(TxChar);
+  return OK;
+}
+
+void
+host_uart_rx(const char *buf, size_t len)
+{
+  // Same burst size as the hardware RX FIFO the ISR unloads
+  uint8_t burst[UART_FIFO_LEN];
+  size_t index, n;
+  uint8_t got_cr;
+  CPU_ENTER(cpu);
+
+  while (len)
+  {
+    n = len < sizeof(burst) ? len : sizeof(burst);
+    got_cr = 0;
+    for (index = 0; index < n; index++)
+    {
+      burst[index] = buf[index];
+      // A terminal sends CR on return, a pipe sends LF
+      if (burst[index] == '\n')
+      {
+        burst[index] = '\r';
+      }
+      got_cr |= (burst[index] == '\r');
+    }
+    ringbuf_spsc_put(rxBuff, burst, n);
+    fwrite(burst, 1, n, stdout);
+    if (got_cr)
+    {
+      task_post_intr(SIG_CONSOLE_RX, 0);
+    }
+    buf += n;
+    len -= n;
+  }
+  CPU_EXIT(cpu, CPU_UART_ISR);
+}
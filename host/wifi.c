@@ -0,0 +1,449 @@
+/*
+ * wifi.c - Host stand-ins for the ESP8266 WiFi, DHCP server and espconn
+ * APIs.
+ *
+ * Two netifs are simulated. The station gets an address shortly after
+ * wifi_station_connect() (or auto connect); the SoftAP netif is only on
+ * netif_list while the opmode includes SOFTAP_MODE, and comes back with
+ * fresh input/linkoutput functions each time, like the SDK does.
+ */
+#include "c_types.h"
+#include "mem.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "lwip/ip.h"
+#include "lwip/app/dhcpserver.h"
+#include "lwip/app/espconn.h"
+
+#include "host.h"
+
+#define HOST_CONNECT_DELAY 100   // ms from connect to EVENT_STAMODE_CONNECTED
+#define HOST_DHCP_DELAY    200   // ms from connected to EVENT_STAMODE_GOT_IP
+
+struct netif host_netif_sta;
+struct netif host_netif_ap;
+uint32_t host_wifi_flash_writes;
+
+static uint8 opmode = STATION_MODE;
+static uint8 phy = PHY_MODE_11N;
+static uint8 mac_sta[6] = { 0x5c, 0xcf, 0x7f, 0x00, 0x00, 0x01 };
+static uint8 mac_ap[6] = { 0x5e, 0xcf, 0x7f, 0x00, 0x00, 0x01 };
+static struct station_config sta_config;
+static struct softap_config ap_config;
+static wifi_event_handler_cb_t event_cb;
+static bool sta_connected, sta_static_ip;
+static os_timer_t connect_timer;
+
+static struct dhcps_pool dhcps_table[MAX_STATION_NUM];
+static uint16 dhcps_count;
+static uint8 stations;
+
+static err_t
+host_input_sink(struct pbuf *p, struct netif *inp)
+{
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static err_t
+host_linkoutput_sink(struct netif *outp, struct pbuf *p)
+{
+  return ERR_OK;
+}
+
+static void
+netif_reset(struct netif *nif)
+{
+  nif->input = host_input_sink;
+  nif->linkoutput = host_linkoutput_sink;
+  nif->napt = 0;
+  nif->mtu = 1500;
+  nif->hwaddr_len = 6;
+}
+
+static void
+netif_link(struct netif *nif, bool up)
+{
+  struct netif **pp;
+
+  for (pp = &netif_list; *pp != NULL && *pp != nif; pp = &(*pp)->next);
+  if (up && *pp == NULL)
+  {
+    netif_reset(nif);
+    nif->next = netif_list;
+    netif_list = nif;
+  }
+  else if (!up && *pp != NULL)
+  {
+    *pp = nif->next;
+    nif->next = NULL;
+  }
+}
+
+void
+host_wifi_init(void)
+{
+  netif_reset(&host_netif_sta);
+  host_netif_sta.name[0] = 'e';
+  host_netif_sta.name[1] = 'w';
+  host_netif_sta.num = 0;
+
+  netif_reset(&host_netif_ap);
+  host_netif_ap.name[0] = 'a';
+  host_netif_ap.name[1] = 'p';
+  host_netif_ap.num = 1;
+  IP4_ADDR(&host_netif_ap.ip_addr, 192, 168, 4, 1);
+
+  netif_list = NULL;
+  netif_link(&host_netif_sta, true);
+  os_memcpy(host_netif_sta.hwaddr, mac_sta, 6);
+}
+
+static void
+raise_event(System_Event_t *evt)
+{
+  if (event_cb != NULL)
+  {
+    event_cb(evt);
+  }
+}
+
+static void
+connect_timer_func(void *arg)
+{
+  System_Event_t evt;
+
+  os_memset(&evt, 0, sizeof(evt));
+  if (!sta_connected)
+  {
+    sta_connected = true;
+    evt.event = EVENT_STAMODE_CONNECTED;
+    os_memcpy(evt.event_info.connected.ssid, sta_config.ssid, 32);
+    evt.event_info.connected.ssid_len = os_strlen((char *)sta_config.ssid);
+    evt.event_info.connected.channel = 6;
+    raise_event(&evt);
+    os_timer_arm(&connect_timer, HOST_DHCP_DELAY, 0);
+    return;
+  }
+
+  if (!sta_static_ip)
+  {
+    IP4_ADDR(&host_netif_sta.ip_addr, 192, 168, 1, 100);
+    IP4_ADDR(&host_netif_sta.netmask, 255, 255, 255, 0);
+    IP4_ADDR(&host_netif_sta.gw, 192, 168, 1, 1);
+  }
+  evt.event = EVENT_STAMODE_GOT_IP;
+  evt.event_info.got_ip.ip = host_netif_sta.ip_addr;
+  evt.event_info.got_ip.mask = host_netif_sta.netmask;
+  evt.event_info.got_ip.gw = host_netif_sta.gw;
+  raise_event(&evt);
+}
+
+/*
+ * WiFi
+ */
+uint8
+wifi_get_opmode(void)
+{
+  return opmode;
+}
+
+// The _current variants leave the settings the SDK keeps in flash alone
+bool
+wifi_set_opmode(uint8 mode)
+{
+  host_wifi_flash_writes++;
+  return wifi_set_opmode_current(mode);
+}
+
+bool
+wifi_set_opmode_current(uint8 mode)
+{
+  if (mode > STATIONAP_MODE)
+  {
+    return false;
+  }
+  opmode = mode;
+  netif_link(&host_netif_ap, (mode & SOFTAP_MODE) != 0);
+  if (!(mode & SOFTAP_MODE))
+  {
+    stations = 0;
+  }
+  return true;
+}
+
+bool
+wifi_get_macaddr(uint8 if_index, uint8 *macaddr)
+{
+  os_memcpy(macaddr, if_index == SOFTAP_IF ? mac_ap : mac_sta, 6);
+  return true;
+}
+
+bool
+wifi_set_macaddr(uint8 if_index, uint8 *macaddr)
+{
+  if (if_index == SOFTAP_IF)
+  {
+    os_memcpy(mac_ap, macaddr, 6);
+    os_memcpy(host_netif_ap.hwaddr, macaddr, 6);
+  }
+  else
+  {
+    os_memcpy(mac_sta, macaddr, 6);
+    os_memcpy(host_netif_sta.hwaddr, macaddr, 6);
+  }
+  return true;
+}
+
+bool
+wifi_get_ip_info(uint8 if_index, struct ip_info *info)
+{
+  struct netif *nif = if_index == SOFTAP_IF ? &host_netif_ap : &host_netif_sta;
+
+  info->ip = nif->ip_addr;
+  info->netmask = nif->netmask;
+  info->gw = nif->gw;
+  return true;
+}
+
+bool
+wifi_set_ip_info(uint8 if_index, struct ip_info *info)
+{
+  struct netif *nif = if_index == SOFTAP_IF ? &host_netif_ap : &host_netif_sta;
+
+  nif->ip_addr = info->ip;
+  nif->netmask = info->netmask;
+  nif->gw = info->gw;
+  if (if_index == STATION_IF)
+  {
+    sta_static_ip = true;
+  }
+  return true;
+}
+
+void
+wifi_set_event_handler_cb(wifi_event_handler_cb_t cb)
+{
+  event_cb = cb;
+}
+
+enum phy_mode
+wifi_get_phy_mode(void)
+{
+  return phy;
+}
+
+bool
+wifi_set_phy_mode(enum phy_mode mode)
+{
+  if (mode < PHY_MODE_11B || mode > PHY_MODE_11N)
+  {
+    return false;
+  }
+  phy = mode;
+  return true;
+}
+
+bool
+wifi_station_set_config(struct station_config *config)
+{
+  sta_config = *config;
+  return true;
+}
+
+bool
+wifi_station_connect(void)
+{
+  if (sta_connected || sta_config.ssid[0] == 0)
+  {
+    return false;
+  }
+  os_timer_setfn(&connect_timer, connect_timer_func, NULL);
+  os_timer_arm(&connect_timer, HOST_CONNECT_DELAY, 0);
+  return true;
+}
+
+bool
+wifi_station_disconnect(void)
+{
+  System_Event_t evt;
+
+  os_timer_disarm(&connect_timer);
+  if (!sta_connected)
+  {
+    return false;
+  }
+  sta_connected = false;
+  os_memset(&evt, 0, sizeof(evt));
+  evt.event = EVENT_STAMODE_DISCONNECTED;
+  os_memcpy(evt.event_info.disconnected.ssid, sta_config.ssid, 32);
+  evt.event_info.disconnected.reason = 8; // REASON_ASSOC_LEAVE
+  raise_event(&evt);
+  return true;
+}
+
+bool
+wifi_station_set_auto_connect(uint8 set)
+{
+  if (set)
+  {
+    wifi_station_connect();
+  }
+  return true;
+}
+
+bool
+wifi_station_set_hostname(char *name)
+{
+  return true;
+}
+
+bool
+wifi_station_dhcpc_stop(void)
+{
+  sta_static_ip = true;
+  return true;
+}
+
+bool
+wifi_softap_get_config(struct softap_config *config)
+{
+  *config = ap_config;
+  return true;
+}
+
+bool
+wifi_softap_set_config(struct softap_config *config)
+{
+  host_wifi_flash_writes++;
+  return wifi_softap_set_config_current(config);
+}
+
+bool
+wifi_softap_set_config_current(struct softap_config *config)
+{
+  ap_config = *config;
+  return true;
+}
+
+uint8
+wifi_softap_get_station_num(void)
+{
+  return stations;
+}
+
+bool
+wifi_softap_dhcps_start(void)
+{
+  return true;
+}
+
+bool
+wifi_softap_dhcps_stop(void)
+{
+  return true;
+}
+
+bool
+wifi_softap_set_dhcps_lease(struct dhcps_lease *please)
+{
+  return true;
+}
+
+void
+host_wifi_station_join(const uint8_t *mac)
+{
+  System_Event_t evt;
+  uint16 i;
+
+  if (!(opmode & SOFTAP_MODE))
+  {
+    return;
+  }
+  for (i = 0; i < dhcps_count && os_memcmp(dhcps_table[i].mac, mac, 6); i++);
+  if (i == dhcps_count && dhcps_count < MAX_STATION_NUM)
+  {
+    os_memcpy(dhcps_table[i].mac, mac, 6);
+    dhcps_table[i].ip = host_netif_ap.ip_addr;
+    ip4_addr4(&dhcps_table[i].ip) = 2 + i;
+    dhcps_table[i].lease_timer = 120;
+    dhcps_count++;
+  }
+  stations++;
+
+  os_memset(&evt, 0, sizeof(evt));
+  evt.event = EVENT_SOFTAPMODE_STACONNECTED;
+  os_memcpy(evt.event_info.sta_connected.mac, mac, 6);
+  evt.event_info.sta_connected.aid = stations;
+  raise_event(&evt);
+}
+
+void
+host_wifi_station_leave(const uint8_t *mac)
+{
+  System_Event_t evt;
+
+  if (stations == 0)
+  {
+    return;
+  }
+  os_memset(&evt, 0, sizeof(evt));
+  evt.event = EVENT_SOFTAPMODE_STADISCONNECTED;
+  os_memcpy(evt.event_info.sta_disconnected.mac, mac, 6);
+  evt.event_info.sta_disconnected.aid = stations--;
+  raise_event(&evt);
+}
+
+/*
+ * DHCP server
+ */
+void
+dhcps_set_DNS(struct ip_addr *dns_ip)
+{
+}
+
+struct dhcps_pool *
+dhcps_get_mapping(uint16_t no)
+{
+  return no < dhcps_count ? &dhcps_table[no] : NULL;
+}
+
+void
+dhcps_set_mapping(struct ip_addr *addr, uint8 *mac, uint32 lease_time)
+{
+  uint16 i;
+
+  for (i = 0; i < dhcps_count && os_memcmp(dhcps_table[i].mac, mac, 6); i++);
+  if (i == MAX_STATION_NUM)
+  {
+    return;
+  }
+  dhcps_table[i].ip = *addr;
+  os_memcpy(dhcps_table[i].mac, mac, 6);
+  dhcps_table[i].lease_timer = lease_time;
+  if (i == dhcps_count)
+  {
+    dhcps_count++;
+  }
+}
+
+/*
+ * espconn
+ */
+sint8
+espconn_sent(struct espconn *espconn, uint8 *psent, uint16 length)
+{
+  fwrite(psent, 1, length, stdout);
+  return 0;
+}
+
+sint8
+espconn_disconnect(struct espconn *espconn)
+{
+  return 0;
+}
+
+void
+espconn_dns_setserver(char numdns, ip_addr_t *dnsserver)
+{
+}
@@ -0,0 +1,25 @@
+#ifndef _CCOUNT_H_
+#define _CCOUNT_H_
+
+#include "c_types.h"
+
+// Xtensa cycle counter, counts at the CPU clock and wraps every
+// 2^32 cycles (53 s at 80 MHz)
+static inline uint32_t
+ccount_read(void)
+{
+  uint32_t ccount;
+
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+  return ccount;
+}
+
+// Cycles for CPU time accounting. There is one CPU and nothing else
+// running on it while a context is timed, so that is the same counter.
+static inline uint32_t
+ccount_cpu_read(void)
+{
+  return ccount_read();
+}
+
+#endif
@@ -36,6 +36,9 @@
 #ifdef _ENABLE_RING_BUFFER
     #include "ringbuf.h"
     #define RX_RING_BUFFER_SIZE 250
+    // Two refills of the Tx FIFO, plus room for the echo. The console
+    // keeps its own 1 KiB buffer, UART_Send waits out longer responses
+    #define TX_RING_BUFFER_SIZE 256
 #endif
 
 
@@ -224,6 +227,9 @@ void UART_SetPrintPort(uint8 uart_no);
 bool UART_CheckOutputFinished(uint8 uart_no, uint32 time_out_us);
 //==============================================
 
+int UART_Recv(uint8 uart_no, char *buffer, int max_buf_len);
+int UART_Send(uint8 uart_no, char *buffer, int len);
+
 void UART_init_console(UartBautRate uart0_br,
                        uint8 recv_task_priority,
                        ringbuf_t rxbuffer,
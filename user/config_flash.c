@@ -1,6 +1,9 @@
+#include <stddef.h>
+
 #include "user_interface.h"
 #include "lwip/ip.h"
 #include "config_flash.h"
+#include "mem_stats.h"
 
 
 /*     From the document 99A-SDK-Espressif IOT Flash RW Operation_v0.2      *
@@ -9,14 +12,14 @@
  * time at least. When you want to change some data in flash, you have to
  * erase the whole sector, and then write it back with the new data.
  *--------------------------------------------------------------------------*/
-void
+void ICACHE_FLASH_ATTR
 config_load_default(sysconfig_p config)
 {
-  uint8_t mac[6];
-
-  wifi_get_macaddr(STATION_IF, mac);
+  uint8_t *mac = config->STA_MAC_address;
+  uint8_t i;
 
   os_memset(config, 0, sizeof(sysconfig_t));
+  wifi_get_macaddr(STATION_IF, mac);
   os_printf("Loading default configuration\r\n");
   config->magic_number = MAGIC_NUMBER;
   config->length = sizeof(sysconfig_t);
@@ -42,12 +45,10 @@ config_load_default(sysconfig_p config)
   config->clock_speed = 80;
   config->status_led = STATUS_LED_GPIO;
 
-  wifi_get_macaddr(STATION_IF, config->STA_MAC_address);
-
   config->dhcps_entries = 0;
 
-  // NOTE(m): Interval at which to restart the system to select a new
-  // random StreetPass MAC from the list.
+  // NOTE(m): Interval at which to switch the AP to a new random
+  // StreetPass MAC from the list.
   // In seconds. Default: 900 (15 minutes)
   config->system_restart_interval = 900;
 
@@ -55,93 +56,605 @@ config_load_default(sysconfig_p config)
   // In seconds. Default: 90 seconds.
   config->ap_enable_duration = 90;
 
+  // One MAC per AP window
+  config->mac_dwell = 0;
+
   // list of mac addresses
   // from https://docs.google.com/spreadsheets/d/1su5u-vPrQwkTixR6YnOTWSi_Ls9lV-_XNJHaWIJspv4/edit#gid=0
-  ets_str2macaddr(config->mac_list[0], "4E:53:50:4F:4F:40");
-  ets_str2macaddr(config->mac_list[1], "4E:53:50:4F:4F:41");
-  ets_str2macaddr(config->mac_list[2], "4E:53:50:4F:4F:42");
-  ets_str2macaddr(config->mac_list[3], "4E:53:50:4F:4F:43");
-  ets_str2macaddr(config->mac_list[4], "4E:53:50:4F:4F:44");
-  ets_str2macaddr(config->mac_list[5], "4E:53:50:4F:4F:45");
-  ets_str2macaddr(config->mac_list[6], "4E:53:50:4F:4F:46");
-  ets_str2macaddr(config->mac_list[7], "4E:53:50:4F:4F:47");
-  ets_str2macaddr(config->mac_list[8], "4E:53:50:4F:4F:48");
-  ets_str2macaddr(config->mac_list[9], "4E:53:50:4F:4F:49");
-  ets_str2macaddr(config->mac_list[10], "4E:53:50:4F:4F:4A");
-  ets_str2macaddr(config->mac_list[11], "4E:53:50:4F:4F:4B");
-  ets_str2macaddr(config->mac_list[12], "4E:53:50:4F:4F:4C");
-  ets_str2macaddr(config->mac_list[13], "4E:53:50:4F:4F:4D");
-  ets_str2macaddr(config->mac_list[14], "4E:53:50:4F:4F:4E");
-  ets_str2macaddr(config->mac_list[15], "4E:53:50:4F:4F:4F");
-}
-
-int
-config_load(sysconfig_p config)
+  // 4E:53:50:4F:4F:40 to 4E:53:50:4F:4F:4F
+  for (i = 0; i < MAC_LIST_LENGTH; i++)
+  {
+    os_memcpy(config->mac_list[i], "NSPOO", 5);
+    config->mac_list[i][5] = 0x40 + i;
+  }
+}
+
+/*
+ * The config log. Every save appends a record to the current sector:
+ * either a full sysconfig_t or, if only a few fields changed since the
+ * last save, a delta with just the changed byte ranges. Only when a
+ * record does not fit anymore is the next sector (round robin) erased,
+ * and it always starts with a full record, so most saves cost a small
+ * page write and the erases are spread over CONFIG_LOG_SECTORS sectors.
+ * At boot the sector with the newest record is replayed from its full
+ * record on; a save cut short by a power loss fails its CRC and the
+ * replay stops at the record before it.
+ */
+#define CONFIG_LOG_MAGIC 0xc5
+#define CONFIG_REC_FULL 1
+#define CONFIG_REC_DELTA 2
+
+typedef struct
 {
-  if (config == NULL)
+  uint8_t magic; // CONFIG_LOG_MAGIC, erased flash reads 0xff
+  uint8_t type; // CONFIG_REC_*
+  uint16_t length; // Payload bytes following the header
+  uint32_t seq; // One more than the record before
+  uint32_t crc; // CRC-32 of the fields above and the payload
+} config_rec_t;
+
+#define CONFIG_REC_SIZE(len) (sizeof(config_rec_t) + (((len) + 3) & ~3))
+
+// A delta payload is a list of these, each followed by len bytes that
+// replace the ones at offset in the sysconfig_t. Not aligned in the payload.
+typedef struct
+{
+  uint16_t offset;
+  uint16_t len;
+} config_delta_t;
+
+// Beyond this a full record is written instead
+#define CONFIG_DELTA_MAX (sizeof(sysconfig_t) / 2)
+
+static bool config_log_scanned;
+static uint8_t config_log_sector; // Sector with the newest record
+static uint16_t config_log_offset; // Where the next record goes in it
+static uint32_t config_log_seq; // Sequence number of the newest record
+
+// The config as the log has it, deltas are made against this
+static sysconfig_t config_saved;
+static bool config_saved_valid;
+
+static uint32_t ICACHE_FLASH_ATTR
+config_crc32(uint32_t crc, const uint8_t *data, uint16_t len)
+{
+  int i;
+
+  crc = ~crc;
+  while (len--)
   {
-    return -1;
+    crc ^= *data++;
+    for (i = 0; i < 8; i++)
+    {
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
   }
-  uint16_t base_address = FLASH_BLOCK_NO;
+  return ~crc;
+}
 
-  spi_flash_read(base_address* SPI_FLASH_SEC_SIZE, &config->magic_number, 4);
+// The CRC covers the header up to the crc field itself
+static uint32_t ICACHE_FLASH_ATTR
+config_rec_hdr_crc(const config_rec_t *rec)
+{
+  return config_crc32(0, (const uint8_t *)rec,
+                      sizeof(config_rec_t) - sizeof(rec->crc));
+}
 
-  if((config->magic_number != MAGIC_NUMBER))
+/*
+ * Check the record header at offset in a log sector. Returns 1 if it
+ * looks like a record, 0 for erased flash and -1 for anything else. The
+ * payload CRC is only checked when the record is replayed.
+ */
+static int ICACHE_FLASH_ATTR
+config_rec_read(uint32_t base, uint16_t offset, config_rec_t *rec)
+{
+  spi_flash_read(base + offset, (uint32 *)rec, sizeof(*rec));
+  if (rec->magic == 0xff && rec->type == 0xff && rec->length == 0xffff)
+  {
+    return 0;
+  }
+  if (rec->magic != CONFIG_LOG_MAGIC ||
+      CONFIG_REC_SIZE(rec->length) > SPI_FLASH_SEC_SIZE - offset)
   {
-    os_printf("\r\nNo config found, saving default in flash\r\n");
-    config_load_default(config);
-    config_save(config);
     return -1;
   }
+  return 1;
+}
+
+// Whether the sector is erased from offset to its end
+static bool ICACHE_FLASH_ATTR
+config_log_erased(uint32_t base, uint16_t offset)
+{
+  uint32_t buf[16];
+  uint16_t i, n;
+
+  // Records are word aligned, so is offset
+  for (; offset < SPI_FLASH_SEC_SIZE; offset += n)
+  {
+    n = SPI_FLASH_SEC_SIZE - offset < sizeof(buf) ?
+        SPI_FLASH_SEC_SIZE - offset : sizeof(buf);
+    spi_flash_read(base + offset, buf, n);
+    for (i = 0; i < n / sizeof(buf[0]); i++)
+    {
+      if (buf[i] != 0xffffffff)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * Walk the record headers of one log sector. Returns the number of
+ * records; *end is where the next record would go, or
+ * SPI_FLASH_SEC_SIZE if the sector ends in anything but erased flash,
+ * so nothing is ever written over a torn record or an old style config.
+ * A save cut short while writing the payload leaves the header erased,
+ * but not the flash behind it, so all of that has to be erased.
+ */
+static uint16_t ICACHE_FLASH_ATTR
+config_log_scan(uint8_t sector, uint16_t *end, uint32_t *last_seq)
+{
+  uint32_t base = (FLASH_BLOCK_NO + sector) * SPI_FLASH_SEC_SIZE;
+  uint16_t offset = 0, count = 0;
+  config_rec_t rec;
+  int valid = 0;
+
+  while (offset + sizeof(rec) <= SPI_FLASH_SEC_SIZE &&
+         (valid = config_rec_read(base, offset, &rec)) > 0)
+  {
+    *last_seq = rec.seq;
+    offset += CONFIG_REC_SIZE(rec.length);
+    count++;
+  }
+
+  *end = (offset + sizeof(rec) > SPI_FLASH_SEC_SIZE ||
+          (valid == 0 && config_log_erased(base, offset))) ?
+         offset : SPI_FLASH_SEC_SIZE;
+  return count;
+}
+
+static void ICACHE_FLASH_ATTR
+config_delta_apply(uint8_t *image, uint16_t size,
+                   const uint8_t *delta, uint16_t len)
+{
+  config_delta_t d;
+
+  while (len >= sizeof(d))
+  {
+    os_memcpy(&d, delta, sizeof(d));
+    delta += sizeof(d);
+    len -= sizeof(d);
+    if (d.len > len || d.offset + d.len > size)
+    {
+      return;
+    }
+    os_memcpy(image + d.offset, delta, d.len);
+    delta += d.len;
+    len -= d.len;
+  }
+}
+
+/*
+ * The fields of sysconfig_t. New fields must only ever be added at the
+ * end of the struct: config_migrate keeps every field that a config of
+ * an older, shorter layout already has and defaults the rest.
+ */
+#define CONFIG_FIELD(f) { offsetof(sysconfig_t, f), sizeof(((sysconfig_t *)0)->f) }
+
+static const struct
+{
+  uint16_t offset;
+  uint16_t size;
+} config_fields[] =
+{
+  CONFIG_FIELD(ssid),
+  CONFIG_FIELD(password),
+  CONFIG_FIELD(auto_connect),
+  CONFIG_FIELD(bssid),
+  CONFIG_FIELD(sta_hostname),
+  CONFIG_FIELD(ap_ssid),
+  CONFIG_FIELD(first_run),
+  CONFIG_FIELD(system_restart_interval),
+  CONFIG_FIELD(ap_enable_duration),
+  CONFIG_FIELD(ap_watchdog),
+  CONFIG_FIELD(client_watchdog),
+  CONFIG_FIELD(network_addr),
+  CONFIG_FIELD(dns_addr),
+  CONFIG_FIELD(my_addr),
+  CONFIG_FIELD(my_netmask),
+  CONFIG_FIELD(my_gw),
+#ifdef PHY_MODE
+  CONFIG_FIELD(phy_mode),
+#endif
+  CONFIG_FIELD(clock_speed),
+  CONFIG_FIELD(status_led),
+  CONFIG_FIELD(STA_MAC_address),
+  CONFIG_FIELD(dhcps_entries),
+  CONFIG_FIELD(dhcps_p),
+  CONFIG_FIELD(mac_list),
+  CONFIG_FIELD(mac_dwell),
+};
+
+static void ICACHE_FLASH_ATTR
+config_migrate(sysconfig_p config, const uint8_t *old, uint16_t old_len)
+{
+  uint8_t i;
+
+  os_printf("Migrating config of %d bytes to %d bytes\r\n",
+            old_len, (int)sizeof(sysconfig_t));
+  config_load_default(config);
+  for (i = 0; i < sizeof(config_fields) / sizeof(config_fields[0]); i++)
+  {
+    if (config_fields[i].offset + config_fields[i].size <= old_len)
+    {
+      os_memcpy((uint8_t *)config + config_fields[i].offset,
+                old + config_fields[i].offset, config_fields[i].size);
+    }
+  }
+}
+
+/*
+ * Rebuild the config from the records of one log sector, reading each
+ * record from flash once and checking its CRC in RAM. A config of
+ * another layout is migrated and *migrated set. Returns the offset
+ * behind the last good record, or 0 if there is no good full record.
+ */
+static uint16_t ICACHE_FLASH_ATTR
+config_log_replay(uint8_t sector, sysconfig_p config, bool *migrated)
+{
+  uint32_t base = (FLASH_BLOCK_NO + sector) * SPI_FLASH_SEC_SIZE;
+  uint16_t offset = 0, good = 0;
+  uint8_t *old = NULL; // Image of another layout, if the sector has one
+  uint16_t old_len = 0;
+  config_rec_t rec;
+
+  while (offset + sizeof(rec) <= SPI_FLASH_SEC_SIZE &&
+         config_rec_read(base, offset, &rec) > 0)
+  {
+    uint8_t *payload = (uint8_t *)mem_alloc(MEM_CONFIG,
+                                            (rec.length + 3) & ~3);
+
+    if (payload == NULL)
+    {
+      break;
+    }
+    spi_flash_read(base + offset + sizeof(rec), (uint32 *)payload,
+                   (rec.length + 3) & ~3);
+    if (config_crc32(config_rec_hdr_crc(&rec), payload, rec.length) !=
+        rec.crc)
+    {
+      // Cut short by a power loss, nothing behind it counts
+      mem_free(MEM_CONFIG, payload);
+      break;
+    }
+
+    if (rec.type == CONFIG_REC_FULL)
+    {
+      mem_free(MEM_CONFIG, old);
+      old = NULL;
+      if (rec.length == sizeof(sysconfig_t))
+      {
+        os_memcpy(config, payload, sizeof(sysconfig_t));
+        mem_free(MEM_CONFIG, payload);
+      }
+      else
+      {
+        old = payload;
+        old_len = rec.length;
+      }
+      good = offset + CONFIG_REC_SIZE(rec.length);
+    }
+    else
+    {
+      if (rec.type == CONFIG_REC_DELTA && good != 0)
+      {
+        config_delta_apply(old ? old : (uint8_t *)config,
+                           old ? old_len : sizeof(sysconfig_t),
+                           payload, rec.length);
+        good = offset + CONFIG_REC_SIZE(rec.length);
+      }
+      mem_free(MEM_CONFIG, payload);
+    }
+    offset += CONFIG_REC_SIZE(rec.length);
+  }
+
+  if (old != NULL)
+  {
+    config_migrate(config, old, old_len);
+    mem_free(MEM_CONFIG, old);
+    *migrated = true;
+  }
+  return good;
+}
+
+/*
+ * Load the newest config from the log and set up the append position.
+ * The sectors are tried newest first, in case the full record a fresh
+ * sector starts with was cut short. Returns false if there is none.
+ */
+static bool ICACHE_FLASH_ATTR
+config_log_load(sysconfig_p config, bool *migrated)
+{
+  uint16_t end[CONFIG_LOG_SECTORS];
+  uint32_t last_seq[CONFIG_LOG_SECTORS];
+  bool tried[CONFIG_LOG_SECTORS];
+  uint8_t sector, newest = 0;
+  bool found = false;
+
+  // Until a record is found, the first save goes to the second sector
+  // and leaves an old style config in the first one alone
+  config_log_sector = 0;
+  config_log_offset = SPI_FLASH_SEC_SIZE;
+  config_log_seq = 0;
+  config_log_scanned = true;
+
+  for (sector = 0; sector < CONFIG_LOG_SECTORS; sector++)
+  {
+    tried[sector] = config_log_scan(sector, &end[sector],
+                                    &last_seq[sector]) == 0;
+    if (!tried[sector] && (!found ||
+                           (int32_t)(last_seq[sector] - config_log_seq) > 0))
+    {
+      config_log_seq = last_seq[sector];
+      found = true;
+    }
+  }
+
+  while (found)
+  {
+    uint16_t good;
+
+    found = false;
+    for (sector = 0; sector < CONFIG_LOG_SECTORS; sector++)
+    {
+      if (!tried[sector] && (!found ||
+                             (int32_t)(last_seq[sector] -
+                                       last_seq[newest]) > 0))
+      {
+        newest = sector;
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      break;
+    }
+
+    tried[newest] = true;
+    good = config_log_replay(newest, config, migrated);
+    if (good != 0)
+    {
+      config_log_sector = newest;
+      config_log_offset = good == end[newest] ? good : SPI_FLASH_SEC_SIZE;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Encode the byte ranges in which config differs from config_saved.
+ * Ranges closer together than a range header are merged. Returns the
+ * payload length, or -1 if it would be longer than max.
+ */
+static int ICACHE_FLASH_ATTR
+config_delta_make(const sysconfig_t *config, uint8_t *delta, uint16_t max)
+{
+  const uint8_t *old = (const uint8_t *)&config_saved;
+  const uint8_t *cur = (const uint8_t *)config;
+  uint16_t i = 0, len = 0;
+
+  while (i < sizeof(sysconfig_t))
+  {
+    config_delta_t d;
+    uint16_t same = 0;
+
+    if (old[i] == cur[i])
+    {
+      i++;
+      continue;
+    }
+
+    d.offset = i;
+    while (i < sizeof(sysconfig_t) && same <= sizeof(d))
+    {
+      same = old[i] == cur[i] ? same + 1 : 0;
+      i++;
+    }
+    d.len = i - same - d.offset;
+
+    if (len + sizeof(d) + d.len > max)
+    {
+      return -1;
+    }
+    os_memcpy(delta + len, &d, sizeof(d));
+    os_memcpy(delta + len + sizeof(d), cur + d.offset, d.len);
+    len += sizeof(d) + d.len;
+  }
+  return len;
+}
+
+static void ICACHE_FLASH_ATTR
+config_log_append(uint8_t type, const void *data, uint16_t len)
+{
+  config_rec_t rec;
+  uint32_t addr, tail;
+
+  if (config_log_offset + CONFIG_REC_SIZE(len) > SPI_FLASH_SEC_SIZE)
+  {
+    // Sector full, the new record goes first into the next one
+    config_log_sector = (config_log_sector + 1) % CONFIG_LOG_SECTORS;
+    config_log_offset = 0;
+    spi_flash_erase_sector(FLASH_BLOCK_NO + config_log_sector);
+  }
+
+  rec.magic = CONFIG_LOG_MAGIC;
+  rec.type = type;
+  rec.length = len;
+  rec.seq = config_log_seq + 1;
+  rec.crc = config_crc32(config_rec_hdr_crc(&rec), data, len);
+
+  // Payload first, the header makes the record visible
+  addr = (FLASH_BLOCK_NO + config_log_sector) * SPI_FLASH_SEC_SIZE +
+         config_log_offset + sizeof(rec);
+  spi_flash_write(addr, (uint32 *)data, len & ~3);
+  if (len & 3)
+  {
+    tail = 0xffffffff;
+    os_memcpy(&tail, (const uint8_t *)data + (len & ~3), len & 3);
+    spi_flash_write(addr + (len & ~3), &tail, sizeof(tail));
+  }
+  spi_flash_write(addr - sizeof(rec), (uint32 *)&rec, sizeof(rec));
+
+  config_log_offset += CONFIG_REC_SIZE(len);
+  config_log_seq = rec.seq;
+}
 
-  os_printf("\r\nConfig found and loaded\r\n");
-  spi_flash_read(base_address * SPI_FLASH_SEC_SIZE,
-                 (uint32 *) config,
-                 sizeof(sysconfig_t));
-  if (config->length != sizeof(sysconfig_t))
+int ICACHE_FLASH_ATTR
+config_load(sysconfig_p config)
+{
+  // The start of a sysconfig_t of any layout
+  struct
+  {
+    uint32_t magic_number;
+    uint16_t length;
+  } legacy;
+  bool migrated = false;
+
+  if (config == NULL)
   {
-    os_printf("Length Mismatch, probably old version of config, loading defaults\r\n");
-    config_load_default(config);
-    config_save(config);
     return -1;
   }
 
-  return 0;
+  // Nothing is written at boot; a migrated or default config goes to
+  // flash with the next save, as a full record
+  if (config_log_load(config, &migrated))
+  {
+    config_saved_valid = !migrated;
+    if (config_saved_valid)
+    {
+      os_memcpy(&config_saved, config, sizeof(sysconfig_t));
+    }
+    os_printf("\r\nConfig found and loaded\r\n");
+    return 0;
+  }
+  config_saved_valid = false;
+
+  // Take over a config from before the log
+  spi_flash_read(FLASH_BLOCK_NO * SPI_FLASH_SEC_SIZE,
+                 (uint32 *)&legacy, sizeof(legacy));
+  if (legacy.magic_number == MAGIC_NUMBER)
+  {
+    uint16_t len = legacy.length;
+    uint8_t *old;
+
+    os_printf("\r\nOld style config found\r\n");
+    if (len == sizeof(sysconfig_t))
+    {
+      spi_flash_read(FLASH_BLOCK_NO * SPI_FLASH_SEC_SIZE,
+                     (uint32 *)config, sizeof(sysconfig_t));
+      return 0;
+    }
+    if (len >= sizeof(legacy) && len <= SPI_FLASH_SEC_SIZE &&
+        (old = (uint8_t *)mem_alloc(MEM_CONFIG, (len + 3) & ~3)) != NULL)
+    {
+      spi_flash_read(FLASH_BLOCK_NO * SPI_FLASH_SEC_SIZE,
+                     (uint32 *)old, (len + 3) & ~3);
+      config_migrate(config, old, len);
+      mem_free(MEM_CONFIG, old);
+      return 0;
+    }
+  }
+
+  os_printf("\r\nNo config found, using defaults\r\n");
+  config_load_default(config);
+  return -1;
 }
 
-void
+void ICACHE_FLASH_ATTR
 config_save(sysconfig_p config)
 {
-  uint16_t base_address = FLASH_BLOCK_NO;
+  uint8_t *delta = NULL;
+  int len = -1;
+
   os_printf("Saving configuration\r\n");
-  spi_flash_erase_sector(base_address);
-  spi_flash_write(base_address * SPI_FLASH_SEC_SIZE,
-                  (uint32 *)config,
-                  sizeof(sysconfig_t));
+
+  if (!config_log_scanned)
+  {
+    bool migrated = false;
+
+    config_saved_valid = config_log_load(&config_saved, &migrated) &&
+                         !migrated;
+  }
+
+  // A delta is only worth it while it is smaller than a full record
+  // and fits behind the full record of the current sector
+  if (config_saved_valid)
+  {
+    delta = (uint8_t *)mem_alloc(MEM_CONFIG, CONFIG_DELTA_MAX);
+  }
+  if (delta != NULL)
+  {
+    len = config_delta_make(config, delta, CONFIG_DELTA_MAX);
+    if (len > 0 &&
+        config_log_offset + CONFIG_REC_SIZE(len) <= SPI_FLASH_SEC_SIZE)
+    {
+      config_log_append(CONFIG_REC_DELTA, delta, len);
+    }
+    else if (len != 0)
+    {
+      len = -1;
+    }
+    mem_free(MEM_CONFIG, delta);
+  }
+  if (len < 0)
+  {
+    config_log_append(CONFIG_REC_FULL, config, sizeof(sysconfig_t));
+  }
+
+  os_memcpy(&config_saved, config, sizeof(sysconfig_t));
+  config_saved_valid = true;
 }
 
-void
+void ICACHE_FLASH_ATTR
 blob_save(uint8_t blob_no, uint32_t *data, uint16_t len)
 {
-  uint16_t base_address = FLASH_BLOCK_NO + 1 + blob_no;
+  uint16_t base_address = BLOB_BLOCK_NO + blob_no;
+
+  if (blob_no >= BLOB_MAX)
+  {
+    return;
+  }
   spi_flash_erase_sector(base_address);
   spi_flash_write(base_address * SPI_FLASH_SEC_SIZE, data, len);
 }
 
-void
+void ICACHE_FLASH_ATTR
 blob_load(uint8_t blob_no, uint32_t *data, uint16_t len)
 {
-  uint16_t base_address = FLASH_BLOCK_NO + 1 + blob_no;
+  uint16_t base_address = BLOB_BLOCK_NO + blob_no;
+
+  if (blob_no >= BLOB_MAX)
+  {
+    return;
+  }
   spi_flash_read(base_address * SPI_FLASH_SEC_SIZE, data, len);
 }
 
-void
+void ICACHE_FLASH_ATTR
 blob_zero(uint8_t blob_no, uint16_t len)
 {
   int i;
   uint8_t z[len];
   os_memset(z, 0,len);
-  uint16_t base_address = FLASH_BLOCK_NO + 1 + blob_no;
+  uint16_t base_address = BLOB_BLOCK_NO + blob_no;
+
+  if (blob_no >= BLOB_MAX)
+  {
+    return;
+  }
   spi_flash_erase_sector(base_address);
   spi_flash_write(base_address * SPI_FLASH_SEC_SIZE, (uint32_t *)z, len);
 }
@@ -14,6 +14,16 @@
 
 #define FLASH_BLOCK_NO 0xc
 
+// The config is kept as an append-only log of records across this many
+// sectors from FLASH_BLOCK_NO on, up to the firmware at 0x10000
+#define CONFIG_LOG_SECTORS 3
+
+// One sector per blob. Beyond the firmware, and below the RF calibration
+// and system parameter sectors the SDK keeps at the end of the 4 MB flash
+// the Makefile flashes for
+#define BLOB_BLOCK_NO 0x3f0
+#define BLOB_MAX 8
+
 #define MAGIC_NUMBER 0x112005fc
 
 // Number of mac addresses in StreetPass relay mac list
@@ -67,8 +77,12 @@ typedef struct
   // Allow 20 slots
   uint8_t mac_list[MAC_LIST_LENGTH][6];
 
+  // Seconds each MAC stays up within one AP window (0: the whole window)
+  int32_t mac_dwell;
+
 } sysconfig_t, *sysconfig_p;
 
+void config_load_default(sysconfig_p config);
 int config_load(sysconfig_p config);
 void config_save(sysconfig_p config);
 
@@ -0,0 +1,32 @@
+#include "c_types.h"
+#include "osapi.h"
+
+#include "cpu_stats.h"
+#include "sys_time.h"
+
+/*
+ * Each context adds the cycles from its entry to its exit. Contexts can
+ * nest, a netif hook may be called from the console task and the UART
+ * interrupt can hit anything, so nested time is charged to both.
+ */
+cpu_stats_t cpu_stats[CPU_CONTEXTS];
+static uint64_t cpu_stats_start_us;
+
+// The task contexts are named after their signal
+const char *cpu_context_name[CPU_CONTEXTS] =
+  {"timer", "UART ISR", "netif AP", "netif STA", "task nothing",
+   "task start server", "task send data", "task UART0", "task console RX",
+   "task console TX", "task console TX raw", "task GPIO"};
+
+void ICACHE_FLASH_ATTR
+cpu_stats_clear(void)
+{
+  os_memset(cpu_stats, 0, sizeof(cpu_stats));
+  cpu_stats_start_us = get_long_systime();
+}
+
+uint64_t ICACHE_FLASH_ATTR
+cpu_stats_wall_us(void)
+{
+  return get_long_systime() - cpu_stats_start_us;
+}
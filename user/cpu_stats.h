@@ -0,0 +1,53 @@
+#ifndef _CPU_STATS_H_
+#define _CPU_STATS_H_
+
+#include "c_types.h"
+#include "user_config.h"
+#include "ccount.h"
+
+// Task signals accounted one by one, see USER_SIGNALS
+#define CPU_TASK_SIGNALS (SIG_GPIO_INT + 1)
+
+typedef enum {CPU_TIMER, CPU_UART_ISR, CPU_NETIF_AP, CPU_NETIF_STA,
+              CPU_TASK, CPU_CONTEXTS = CPU_TASK + CPU_TASK_SIGNALS} CPU_CONTEXT;
+
+typedef struct
+{
+  uint64_t cycles;
+  uint32_t calls;
+  uint32_t max;
+} cpu_stats_t;
+
+extern cpu_stats_t cpu_stats[CPU_CONTEXTS];
+
+#ifdef CPU_STATS
+#define CPU_ENTER(s)            uint32_t s = ccount_cpu_read()
+#define CPU_EXIT(s, context)    cpu_stats_add(context, ccount_cpu_read() - (s))
+#else
+#define CPU_ENTER(s)
+#define CPU_EXIT(s, context)
+#endif
+
+// Inline, as it is called from the UART interrupt, too
+static inline void
+cpu_stats_add(CPU_CONTEXT context, uint32_t cycles)
+{
+  cpu_stats_t *cpu = &cpu_stats[context];
+
+  cpu->cycles += cycles;
+  cpu->calls++;
+  if (cycles > cpu->max)
+  {
+    cpu->max = cycles;
+  }
+}
+
+extern const char *cpu_context_name[CPU_CONTEXTS];
+
+// Starts over, also when the CPU clock changes
+void cpu_stats_clear(void);
+
+// Microseconds since the last cpu_stats_clear()
+uint64_t cpu_stats_wall_us(void);
+
+#endif
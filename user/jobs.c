@@ -0,0 +1,139 @@
+#include "c_types.h"
+#include "osapi.h"
+
+#include "jobs.h"
+#include "sys_time.h"
+#include "cpu_stats.h"
+
+/*
+ * All jobs share one os_timer, armed for the job that is due first. The
+ * jobs are kept sorted by due time, there are only a handful of them,
+ * so the timer only wakes up when there is something to do.
+ */
+static os_timer_t jobs_timer;
+static job_t *jobs;
+static bool jobs_running;
+
+static void ICACHE_FLASH_ATTR
+jobs_insert(job_t *job)
+{
+  job_t **pp;
+
+  for (pp = &jobs; *pp != NULL && (*pp)->due_us <= job->due_us;
+       pp = &(*pp)->next)
+  {
+  }
+  job->next = *pp;
+  *pp = job;
+  job->active = true;
+}
+
+static void ICACHE_FLASH_ATTR
+jobs_remove(job_t *job)
+{
+  job_t **pp;
+
+  for (pp = &jobs; *pp != NULL; pp = &(*pp)->next)
+  {
+    if (*pp == job)
+    {
+      *pp = job->next;
+      break;
+    }
+  }
+  job->next = NULL;
+  job->active = false;
+}
+
+static void ICACHE_FLASH_ATTR
+jobs_arm(void)
+{
+  uint64_t now;
+
+  os_timer_disarm(&jobs_timer);
+  if (jobs == NULL)
+  {
+    return;
+  }
+  // Rounded up, a job never runs early
+  now = get_long_systime();
+  os_timer_arm(&jobs_timer, jobs->due_us > now ?
+               (uint32_t)((jobs->due_us - now + 999) / 1000) : 0, 0);
+}
+
+static void ICACHE_FLASH_ATTR
+jobs_func(void *arg)
+{
+  job_t *job;
+  uint64_t now;
+  CPU_ENTER(cpu);
+
+  jobs_running = true;
+  now = get_long_systime();
+  while (jobs != NULL && jobs->due_us <= now)
+  {
+    job = jobs;
+    jobs_remove(job);
+    if (job->period_ms > 0)
+    {
+      // Keeps its pace, but does not try to catch up after a delay
+      job->due_us += (uint64_t)job->period_ms * 1000;
+      if (job->due_us <= now)
+      {
+        job->due_us = now + (uint64_t)job->period_ms * 1000;
+      }
+      jobs_insert(job);
+    }
+    // Last, the job may stop or restart itself
+    job->func(job->arg);
+  }
+  jobs_running = false;
+
+  jobs_arm();
+  CPU_EXIT(cpu, CPU_TIMER);
+}
+
+void ICACHE_FLASH_ATTR
+jobs_init(void)
+{
+  jobs = NULL;
+  os_timer_setfn(&jobs_timer, jobs_func, NULL);
+}
+
+void ICACHE_FLASH_ATTR
+job_setfn(job_t *job, job_func_t func, void *arg)
+{
+  job->func = func;
+  job->arg = arg;
+  job->next = NULL;
+  job->active = false;
+}
+
+void ICACHE_FLASH_ATTR
+job_start(job_t *job, uint32_t delay_ms, uint32_t period_ms)
+{
+  if (job->active)
+  {
+    jobs_remove(job);
+  }
+  job->due_us = get_long_systime() + (uint64_t)delay_ms * 1000;
+  job->period_ms = period_ms;
+  jobs_insert(job);
+  if (!jobs_running)
+  {
+    jobs_arm();
+  }
+}
+
+void ICACHE_FLASH_ATTR
+job_stop(job_t *job)
+{
+  if (job->active)
+  {
+    jobs_remove(job);
+    if (!jobs_running)
+    {
+      jobs_arm();
+    }
+  }
+}
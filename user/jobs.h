@@ -0,0 +1,30 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include "c_types.h"
+
+typedef void (*job_func_t)(void *arg);
+
+// Owned by the caller, like an os_timer_t
+typedef struct job
+{
+  struct job *next;
+  uint64_t due_us;
+  uint32_t period_ms; // 0 for a one-shot job
+  job_func_t func;
+  void *arg;
+  bool active;
+} job_t;
+
+// Before any job is started
+void jobs_init(void);
+
+void job_setfn(job_t *job, job_func_t func, void *arg);
+
+// Runs the job after delay_ms and then every period_ms, unless that is
+// 0. Starting an active job again reschedules it.
+void job_start(job_t *job, uint32_t delay_ms, uint32_t period_ms);
+
+void job_stop(job_t *job);
+
+#endif
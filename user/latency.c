@@ -0,0 +1,64 @@
+#include "c_types.h"
+#include "osapi.h"
+
+#include "latency.h"
+
+/*
+ * The netif hooks run for every frame, so recording is a handful of
+ * integer operations: no division, and the bucket is the position of the
+ * highest bit set. Cycle counts are unsigned differences, which stay
+ * right across a wrap of the counter.
+ */
+const char *latency_hook_name[LATENCY_HOOKS] =
+  {"input AP", "output AP", "input STA", "output STA"};
+
+static latency_hist_t latency_hist[LATENCY_HOOKS][2];
+
+static void ICACHE_FLASH_ATTR
+latency_add(latency_hist_t *hist, uint32_t cycles)
+{
+  uint32_t v = cycles;
+  uint8_t b = 0;
+
+  while (v >>= 1)
+  {
+    b++;
+  }
+  if (b >= LATENCY_BUCKETS)
+  {
+    b = LATENCY_BUCKETS - 1;
+  }
+
+  hist->bucket[b]++;
+  hist->count++;
+  hist->sum += cycles;
+  if (cycles > hist->max)
+  {
+    hist->max = cycles;
+  }
+}
+
+void ICACHE_FLASH_ATTR
+latency_record(LATENCY_HOOK hook, const latency_stamp_t *stamp,
+               uint32_t orig_exit)
+{
+  uint32_t now = ccount_read();
+
+  // The hook's own time is up to the call of the original function, and
+  // from its return up to here
+  latency_add(&latency_hist[hook][1], orig_exit - stamp->orig);
+  latency_add(&latency_hist[hook][0],
+              (stamp->orig - stamp->enter) + (now - orig_exit));
+}
+
+const latency_hist_t * ICACHE_FLASH_ATTR
+latency_get(LATENCY_HOOK hook, bool orig)
+{
+  return &latency_hist[hook][orig ? 1 : 0];
+}
+
+void ICACHE_FLASH_ATTR
+latency_clear(void)
+{
+  os_memset(latency_hist, 0, sizeof(latency_hist));
+}
@@ -0,0 +1,53 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include "c_types.h"
+#include "user_config.h"
+#include "ccount.h"
+
+// Histogram buckets, bucket b counts times of 2^b up to 2^(b+1)-1
+// cycles, the last one everything longer
+#define LATENCY_BUCKETS 24
+
+typedef enum {LATENCY_INPUT_AP, LATENCY_OUTPUT_AP, LATENCY_INPUT_STA,
+              LATENCY_OUTPUT_STA, LATENCY_HOOKS} LATENCY_HOOK;
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t bucket[LATENCY_BUCKETS];
+} latency_hist_t;
+
+// Cycle counts taken in a netif hook
+typedef struct
+{
+  uint32_t enter; // Hook entered
+  uint32_t orig; // Original lwIP function called
+} latency_stamp_t;
+
+#ifdef LATENCY_STATS
+#define LATENCY_ENTER(s)        latency_stamp_t s; s.enter = ccount_read()
+#define LATENCY_ORIG(s)         s.orig = ccount_read()
+#define LATENCY_EXIT(s, hook)   latency_record(hook, &s, ccount_read())
+#else
+#define LATENCY_ENTER(s)
+#define LATENCY_ORIG(s)
+#define LATENCY_EXIT(s, hook)
+#endif
+
+extern const char *latency_hook_name[LATENCY_HOOKS];
+
+// Adds the time spent in the hook itself and in the original function
+// it called, which returned at cycle count orig_exit
+void latency_record(LATENCY_HOOK hook, const latency_stamp_t *stamp,
+                    uint32_t orig_exit);
+
+// Returns the histogram of a hook's own time, or of the original
+// function it calls if orig is set
+const latency_hist_t *latency_get(LATENCY_HOOK hook, bool orig);
+
+void latency_clear(void);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stddef.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "user_interface.h"
+
+#include "user_config.h"
+#include "mac_bag.h"
+
+/*
+ * A shuffle bag: the indexes are put into a random order and handed out
+ * one after the other; when the bag is empty it is shuffled again. The
+ * whole state lives in RTC user memory, nothing is kept in RAM, so a
+ * restart picks up where the last one left off. After a power cycle the
+ * checksum does not match and a new bag is started.
+ */
+#define MAC_BAG_MAGIC 0x6d616362
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t seed; // xorshift32 state
+  uint8_t n; // Number of MACs the order was drawn for
+  uint8_t pos; // Next position in order
+  uint8_t last; // Index handed out last
+  uint8_t reserved;
+  uint8_t order[MAC_BAG_MAX];
+  uint32_t check; // Over everything above
+} mac_bag_t;
+
+static uint32_t ICACHE_FLASH_ATTR
+mac_bag_check(const mac_bag_t *bag)
+{
+  const uint32_t *w = (const uint32_t *)bag;
+  uint32_t check = MAC_BAG_MAGIC;
+  uint8_t i;
+
+  for (i = 0; i < offsetof(mac_bag_t, check) / 4; i++)
+  {
+    check = ((check << 5) | (check >> 27)) ^ w[i];
+  }
+  return check;
+}
+
+static uint32_t ICACHE_FLASH_ATTR
+mac_bag_rand(uint32_t *seed)
+{
+  uint32_t x = *seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *seed = x;
+}
+
+// Uniform in [0, n), rejecting the values that would favour low results
+static uint8_t ICACHE_FLASH_ATTR
+mac_bag_uniform(uint32_t *seed, uint8_t n)
+{
+  uint32_t limit = 0xffffffff - 0xffffffff % n;
+  uint32_t r;
+
+  do
+  {
+    r = mac_bag_rand(seed);
+  } while (r >= limit);
+  return r % n;
+}
+
+static void ICACHE_FLASH_ATTR
+mac_bag_shuffle(mac_bag_t *bag, uint8_t n)
+{
+  uint8_t i, j, t;
+
+  for (i = 0; i < n; i++)
+  {
+    bag->order[i] = i;
+  }
+  // Fisher-Yates
+  for (i = n - 1; i > 0; i--)
+  {
+    j = mac_bag_uniform(&bag->seed, i + 1);
+    t = bag->order[i];
+    bag->order[i] = bag->order[j];
+    bag->order[j] = t;
+  }
+  // Don't start the new round with the last one of the old
+  if (n > 1 && bag->order[0] == bag->last)
+  {
+    j = 1 + mac_bag_uniform(&bag->seed, n - 1);
+    bag->order[0] = bag->order[j];
+    bag->order[j] = bag->last;
+  }
+  bag->n = n;
+  bag->pos = 0;
+}
+
+uint8_t ICACHE_FLASH_ATTR
+mac_bag_next(uint8_t n)
+{
+  mac_bag_t bag;
+  uint8_t index;
+
+  if (n == 0)
+  {
+    return 0;
+  }
+  if (n > MAC_BAG_MAX)
+  {
+    n = MAC_BAG_MAX;
+  }
+
+  if (!system_rtc_mem_read(RTC_MAC_BAG_ADDR, &bag, sizeof(bag)) ||
+      bag.magic != MAC_BAG_MAGIC || bag.check != mac_bag_check(&bag) ||
+      bag.n != n)
+  {
+    // Power on, or the list changed
+    os_memset(&bag, 0, sizeof(bag));
+    bag.magic = MAC_BAG_MAGIC;
+    bag.seed = system_get_rtc_time() ^ (system_get_time() << 16);
+    if (bag.seed == 0)
+    {
+      bag.seed = MAC_BAG_MAGIC;
+    }
+    bag.last = 0xff;
+    bag.pos = n;
+  }
+
+  if (bag.pos >= n)
+  {
+    mac_bag_shuffle(&bag, n);
+  }
+  index = bag.order[bag.pos++];
+  bag.last = index;
+
+  bag.check = mac_bag_check(&bag);
+  system_rtc_mem_write(RTC_MAC_BAG_ADDR, &bag, sizeof(bag));
+  return index;
+}
@@ -0,0 +1,15 @@
+#ifndef _MAC_BAG_H_
+#define _MAC_BAG_H_
+
+#include "c_types.h"
+
+// Most MACs a bag can hold
+#define MAC_BAG_MAX 32
+
+// Returns the next index into a list of n MACs. Every index comes up
+// once, in a random order, before any of them repeats, and the same one
+// never comes up twice in a row. The order and the position in it are
+// kept in RTC memory, so this carries on across restarts.
+uint8_t mac_bag_next(uint8_t n);
+
+#endif
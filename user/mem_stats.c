@@ -0,0 +1,89 @@
+#include "c_types.h"
+#include "osapi.h"
+#include "mem.h"
+#include "user_interface.h"
+
+#include "mem_stats.h"
+
+// Resolution of the largest block probe
+#define MEM_PROBE_STEP 16
+
+const char *mem_user_name[MEM_USERS] = {"ringbuf", "console", "config"};
+
+static mem_user_stats_t mem_users[MEM_USERS];
+static uint32_t mem_free_min = 0xffffffff;
+
+void * ICACHE_FLASH_ATTR
+mem_alloc(MEM_USER user, size_t size)
+{
+  void *p = os_malloc(size);
+
+  if (p != NULL)
+  {
+    mem_users[user].allocs++;
+  }
+  else
+  {
+    mem_users[user].failed++;
+  }
+  // Catch the peaks between two timer ticks, too
+  mem_sample();
+  return p;
+}
+
+void ICACHE_FLASH_ATTR
+mem_free(MEM_USER user, void *p)
+{
+  if (p != NULL)
+  {
+    mem_users[user].frees++;
+    os_free(p);
+  }
+}
+
+void ICACHE_FLASH_ATTR
+mem_sample(void)
+{
+  uint32_t heap = system_get_free_heap_size();
+
+  if (heap < mem_free_min)
+  {
+    mem_free_min = heap;
+  }
+}
+
+uint32_t ICACHE_FLASH_ATTR
+mem_min_free(void)
+{
+  return mem_free_min;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+mem_largest_block(void)
+{
+  // Binary search between nothing and all of the free heap
+  uint32_t lo = 0, hi = system_get_free_heap_size() / MEM_PROBE_STEP;
+
+  while (lo < hi)
+  {
+    uint32_t mid = (lo + hi + 1) / 2;
+    void *p = os_malloc(mid * MEM_PROBE_STEP);
+
+    if (p != NULL)
+    {
+      os_free(p);
+      lo = mid;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+  return lo * MEM_PROBE_STEP;
+}
+
+const mem_user_stats_t * ICACHE_FLASH_ATTR
+mem_user_stats(MEM_USER user)
+{
+  return &mem_users[user];
+}
@@ -0,0 +1,34 @@
+#ifndef _MEM_STATS_H_
+#define _MEM_STATS_H_
+
+#include "c_types.h"
+
+// Who an allocation is made for
+typedef enum {MEM_RINGBUF, MEM_CONSOLE, MEM_CONFIG, MEM_USERS} MEM_USER;
+
+typedef struct
+{
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t failed;
+} mem_user_stats_t;
+
+extern const char *mem_user_name[MEM_USERS];
+
+// os_malloc() and os_free(), counted for user
+void *mem_alloc(MEM_USER user, size_t size);
+void mem_free(MEM_USER user, void *p);
+
+// Takes the free heap into the low water mark
+void mem_sample(void);
+
+// Lowest free heap seen since boot
+uint32_t mem_min_free(void);
+
+// Largest block os_malloc() can hand out right now. There is no SDK call
+// for it, so it is probed with test allocations; not for a hot path.
+uint32_t mem_largest_block(void);
+
+const mem_user_stats_t *mem_user_stats(MEM_USER user);
+
+#endif
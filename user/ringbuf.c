@@ -24,6 +24,7 @@
 
 #include "osapi.h"
 #include "mem.h"
+#include "mem_stats.h"
 
 #define assert(x)
 
@@ -33,28 +34,38 @@
  * bugs. Feel free to optimize the code and to remove asserts for use
  * in your own projects, once you're comfortable that it functions as
  * intended.
+ *
+ * The internal buffer is rounded up to a power of two and head and
+ * tail are free-running byte counters: the number of bytes used is
+ * always head - tail (modulo 2^32), and a counter is turned into a
+ * position in the buffer by masking it. That avoids the division the
+ * old pointer based wrap needed on every byte and no byte is sacrificed
+ * to tell "full" from "empty", so the usable capacity is the whole
+ * rounded up buffer.
  */
 
 struct ringbuf_t
 {
     uint8_t *buf;
-    uint8_t *head, *tail;
-    size_t size;
+    uint32_t head, tail;
+    uint32_t mask;
 };
 
 ringbuf_t
 ringbuf_new(size_t capacity)
 {
-    ringbuf_t rb = (ringbuf_t)os_malloc(sizeof(struct ringbuf_t));
+    ringbuf_t rb = (ringbuf_t)mem_alloc(MEM_RINGBUF, sizeof(struct ringbuf_t));
     if (rb) {
+        size_t size = 1;
 
-        /* One byte is used for detecting the full condition. */
-        rb->size = capacity + 1;
-        rb->buf = (uint8_t *)os_malloc(rb->size);
+        while (size < capacity)
+            size <<= 1;
+        rb->mask = size - 1;
+        rb->buf = (uint8_t *)mem_alloc(MEM_RINGBUF, size);
         if (rb->buf)
             ringbuf_reset(rb);
         else {
-            os_free(rb);
+            mem_free(MEM_RINGBUF, rb);
             return 0;
         }
     }
@@ -64,124 +75,113 @@ ringbuf_new(size_t capacity)
 size_t
 ringbuf_buffer_size(const struct ringbuf_t *rb)
 {
-    return rb->size;
+    return rb->mask + 1;
 }
 
 void
 ringbuf_reset(ringbuf_t rb)
 {
-    rb->head = rb->tail = rb->buf;
+    rb->head = rb->tail = 0;
 }
 
 void
 ringbuf_free(ringbuf_t *rb)
 {
     assert(rb && *rb);
-    os_free((*rb)->buf);
-    os_free(*rb);
+    mem_free(MEM_RINGBUF, (*rb)->buf);
+    mem_free(MEM_RINGBUF, *rb);
     *rb = 0;
 }
 
 size_t
 ringbuf_capacity(const struct ringbuf_t *rb)
 {
-    return ringbuf_buffer_size(rb) - 1;
-}
-
-/*
- * Return a pointer to one-past-the-end of the ring buffer's
- * contiguous buffer. You shouldn't normally need to use this function
- * unless you're writing a new ringbuf_* function.
- */
-static const uint8_t *
-ringbuf_end(const struct ringbuf_t *rb)
-{
-    return rb->buf + ringbuf_buffer_size(rb);
+    return rb->mask + 1;
 }
 
 size_t
 ringbuf_bytes_free(const struct ringbuf_t *rb)
 {
-    if (rb->head >= rb->tail)
-        return ringbuf_capacity(rb) - (rb->head - rb->tail);
-    else
-        return rb->tail - rb->head - 1;
+    return ringbuf_capacity(rb) - ringbuf_bytes_used(rb);
 }
 
 size_t
 ringbuf_bytes_used(const struct ringbuf_t *rb)
 {
-    return ringbuf_capacity(rb) - ringbuf_bytes_free(rb);
+    return rb->head - rb->tail;
 }
 
 int
 ringbuf_is_full(const struct ringbuf_t *rb)
 {
-    return ringbuf_bytes_free(rb) == 0;
+    return ringbuf_bytes_used(rb) == ringbuf_capacity(rb);
 }
 
 int
 ringbuf_is_empty(const struct ringbuf_t *rb)
 {
-    return ringbuf_bytes_free(rb) == ringbuf_capacity(rb);
+    return rb->head == rb->tail;
 }
 
 const void *
 ringbuf_tail(const struct ringbuf_t *rb)
 {
-    return rb->tail;
+    return rb->buf + (rb->tail & rb->mask);
 }
 
 const void *
 ringbuf_head(const struct ringbuf_t *rb)
 {
-    return rb->head;
+    return rb->buf + (rb->head & rb->mask);
 }
 
 /*
- * Given a ring buffer rb and a pointer to a location within its
- * contiguous buffer, return the a pointer to the next logical
- * location in the ring buffer.
+ * Copy count bytes into the buffer at counter position pos, wrapping
+ * at the end of the internal buffer. Does not touch head or tail.
  */
-static uint8_t *
-ringbuf_nextp(ringbuf_t rb, const uint8_t *p)
+static void
+ringbuf_write_at(ringbuf_t rb, uint32_t pos, const uint8_t *src,
+                 size_t count)
 {
-    /*
-     * The assert guarantees the expression (++p - rb->buf) is
-     * non-negative; therefore, the modulus operation is safe and
-     * portable.
-     */
-    assert((p >= rb->buf) && (p < ringbuf_end(rb)));
-    return rb->buf + ((++p - rb->buf) % ringbuf_buffer_size(rb));
+    size_t off = pos & rb->mask;
+    size_t n = MIN(ringbuf_buffer_size(rb) - off, count);
+
+    os_memcpy(rb->buf + off, src, n);
+    if (n != count)
+        os_memcpy(rb->buf, src + n, count - n);
 }
 
 void *
 ringbuf_memcpy_into(ringbuf_t dst, const void *src, size_t count)
 {
     const uint8_t *u8src = src;
-    const uint8_t *bufend = ringbuf_end(dst);
-    int overflow = count > ringbuf_bytes_free(dst);
-    size_t nread = 0;
-
-    while (nread != count) {
-        /* don't copy beyond the end of the buffer */
-        assert(bufend > dst->head);
-        size_t n = MIN(bufend - dst->head, count - nread);
-        os_memcpy(dst->head, u8src + nread, n);
-        dst->head += n;
-        nread += n;
-
-        /* wrap? */
-        if (dst->head == bufend)
-            dst->head = dst->buf;
+
+    /* Single bytes are the common case on the UART RX path. */
+    if (count == 1 && !ringbuf_is_full(dst)) {
+        dst->buf[dst->head & dst->mask] = *u8src;
+        dst->head++;
+        return dst->buf + (dst->head & dst->mask);
     }
 
-    if (overflow) {
-        dst->tail = ringbuf_nextp(dst, dst->head);
+    /*
+     * On overflow the oldest data is dropped in FIFO fashion; of an
+     * oversized write only the last 'capacity' bytes survive, so
+     * don't bother copying the rest.
+     */
+    if (count > ringbuf_capacity(dst)) {
+        size_t skip = count - ringbuf_capacity(dst);
+        ringbuf_write_at(dst, dst->head + skip, u8src + skip,
+                         ringbuf_capacity(dst));
+    } else
+        ringbuf_write_at(dst, dst->head, u8src, count);
+    dst->head += count;
+
+    if (ringbuf_bytes_used(dst) > ringbuf_capacity(dst)) {
+        dst->tail = dst->head - ringbuf_capacity(dst);
         assert(ringbuf_is_full(dst));
     }
 
-    return dst->head;
+    return dst->buf + (dst->head & dst->mask);
 }
 
 void *
@@ -192,59 +192,118 @@ ringbuf_memcpy_from(void *dst, ringbuf_t src, size_t count)
         return 0;
 
     uint8_t *u8dst = dst;
-    const uint8_t *bufend = ringbuf_end(src);
-    size_t nwritten = 0;
-    while (nwritten != count) {
-        assert(bufend > src->tail);
-        size_t n = MIN(bufend - src->tail, count - nwritten);
-        os_memcpy(u8dst + nwritten, src->tail, n);
-        src->tail += n;
-        nwritten += n;
-
-        /* wrap ? */
-        if (src->tail == bufend)
-            src->tail = src->buf;
-    }
+    size_t off = src->tail & src->mask;
+    size_t n = MIN(ringbuf_buffer_size(src) - off, count);
+
+    os_memcpy(u8dst, src->buf + off, n);
+    if (n != count)
+        os_memcpy(u8dst + n, src->buf, count - n);
+    src->tail += count;
 
     assert(count + ringbuf_bytes_used(src) == bytes_used);
-    return src->tail;
+    return src->buf + (src->tail & src->mask);
 }
 
 void *
 ringbuf_copy(ringbuf_t dst, ringbuf_t src, size_t count)
 {
-    size_t src_bytes_used = ringbuf_bytes_used(src);
-    if (count > src_bytes_used)
+    struct ringbuf_span span[2];
+
+    if (count > ringbuf_bytes_used(src))
         return 0;
-    int overflow = count > ringbuf_bytes_free(dst);
-
-    const uint8_t *src_bufend = ringbuf_end(src);
-    const uint8_t *dst_bufend = ringbuf_end(dst);
-    size_t ncopied = 0;
-    while (ncopied != count) {
-        assert(src_bufend > src->tail);
-        size_t nsrc = MIN(src_bufend - src->tail, count - ncopied);
-        assert(dst_bufend > dst->head);
-        size_t n = MIN(dst_bufend - dst->head, nsrc);
-        os_memcpy(dst->head, src->tail, n);
-        src->tail += n;
-        dst->head += n;
-        ncopied += n;
-
-        /* wrap ? */
-        if (src->tail == src_bufend)
-            src->tail = src->buf;
-        if (dst->head == dst_bufend)
-            dst->head = dst->buf;
-    }
 
-    assert(count + ringbuf_bytes_used(src) == src_bytes_used);
-    
-    if (overflow) {
-        dst->tail = ringbuf_nextp(dst, dst->head);
-        assert(ringbuf_is_full(dst));
+    ringbuf_peek(src, span);
+    if (count <= span[0].len)
+        ringbuf_memcpy_into(dst, span[0].base, count);
+    else {
+        ringbuf_memcpy_into(dst, span[0].base, span[0].len);
+        ringbuf_memcpy_into(dst, span[1].base, count - span[0].len);
     }
+    ringbuf_consume(src, count);
+
+    return dst->buf + (dst->head & dst->mask);
+}
+
+size_t
+ringbuf_peek(const struct ringbuf_t *rb, struct ringbuf_span span[2])
+{
+    size_t used = ringbuf_bytes_used(rb);
+    size_t off = rb->tail & rb->mask;
+
+    span[0].base = rb->buf + off;
+    span[0].len = MIN(ringbuf_buffer_size(rb) - off, used);
+    span[1].base = rb->buf;
+    span[1].len = used - span[0].len;
+
+    return used;
+}
+
+void *
+ringbuf_consume(ringbuf_t rb, size_t count)
+{
+    if (count > ringbuf_bytes_used(rb))
+        return 0;
+
+    rb->tail += count;
+    return rb->buf + (rb->tail & rb->mask);
+}
+
+size_t
+ringbuf_reserve(ringbuf_t rb, struct ringbuf_span span[2])
+{
+    size_t free = ringbuf_bytes_free(rb);
+    size_t off = rb->head & rb->mask;
+
+    span[0].base = rb->buf + off;
+    span[0].len = MIN(ringbuf_buffer_size(rb) - off, free);
+    span[1].base = rb->buf;
+    span[1].len = free - span[0].len;
+
+    return free;
+}
+
+void *
+ringbuf_commit(ringbuf_t rb, size_t count)
+{
+    if (count > ringbuf_bytes_free(rb))
+        return 0;
 
-    return dst->head;
+    rb->head += count;
+    return rb->buf + (rb->head & rb->mask);
 }
 
+/*
+ * The counters are naturally aligned 32 bit words, so plain loads and
+ * stores of them are atomic on the ESP8266 (and on the host). The
+ * __atomic builtins add the compiler and memory barriers that keep the
+ * data copies on the right side of the counter updates.
+ */
+size_t
+ringbuf_spsc_put(ringbuf_t dst, const void *src, size_t count)
+{
+    uint32_t tail = __atomic_load_n(&dst->tail, __ATOMIC_ACQUIRE);
+    size_t free = ringbuf_capacity(dst) - (dst->head - tail);
+
+    count = MIN(count, free);
+    ringbuf_write_at(dst, dst->head, src, count);
+    __atomic_store_n(&dst->head, dst->head + count, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+size_t
+ringbuf_spsc_get(void *dst, ringbuf_t src, size_t count)
+{
+    uint32_t head = __atomic_load_n(&src->head, __ATOMIC_ACQUIRE);
+    size_t off = src->tail & src->mask;
+    size_t n;
+
+    count = MIN(count, (size_t)(head - src->tail));
+    n = MIN(ringbuf_buffer_size(src) - off, count);
+    os_memcpy(dst, src->buf + off, n);
+    if (n != count)
+        os_memcpy((uint8_t *)dst + n, src->buf, count - n);
+    __atomic_store_n(&src->tail, src->tail + count, __ATOMIC_RELEASE);
+
+    return count;
+}
@@ -24,17 +24,32 @@
  * (e.g., with ringbuf_read). The ring buffer's tail pointer points to
  * the starting location where data should be read when copying data
  * *from* the buffer (e.g., with ringbuf_write).
+ *
+ * Internally the buffer size is a power of two and head and tail are
+ * free-running counters that are masked on access, so advancing them
+ * never needs a division.
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct ringbuf_t *ringbuf_t;
 
 /*
- * Create a new ring buffer with the given capacity (usable
- * bytes). Note that the actual internal buffer size may be one or
- * more bytes larger than the usable capacity, for bookkeeping.
+ * A contiguous region of a ring buffer's internal buffer, as returned
+ * by ringbuf_peek and ringbuf_reserve.
+ */
+struct ringbuf_span
+{
+    uint8_t *base;
+    size_t len;
+};
+
+/*
+ * Create a new ring buffer with at least the given capacity (usable
+ * bytes). Note that the internal buffer size is rounded up to the next
+ * power of two, and the capacity is that rounded up size.
  *
  * Returns the new ring buffer object, or 0 if there's not enough
  * memory to fulfill the request for the given capacity.
@@ -43,12 +58,9 @@ ringbuf_t
 ringbuf_new(size_t capacity);
 
 /*
- * The size of the internal buffer, in bytes. One or more bytes may be
- * unusable in order to distinguish the "buffer full" state from the
- * "buffer empty" state.
- *
- * For the usable capacity of the ring buffer, use the
- * ringbuf_capacity function.
+ * The size of the internal buffer, in bytes. This is the capacity
+ * asked for in ringbuf_new, rounded up to a power of two. Every byte of
+ * it is used.
  */
 size_t
 ringbuf_buffer_size(const struct ringbuf_t *rb);
@@ -67,9 +79,8 @@ void
 ringbuf_reset(ringbuf_t rb);
 
 /*
- * The usable capacity of the ring buffer, in bytes. Note that this
- * value may be less than the ring buffer's internal buffer size, as
- * returned by ringbuf_buffer_size.
+ * The usable capacity of the ring buffer, in bytes. This is always the
+ * same as the internal buffer size, as returned by ringbuf_buffer_size.
  */
 size_t
 ringbuf_capacity(const struct ringbuf_t *rb);
@@ -163,5 +174,83 @@ ringbuf_memcpy_from(void *dst, ringbuf_t src, size_t count);
 void *
 ringbuf_copy(ringbuf_t dst, ringbuf_t src, size_t count);
 
+/*
+ * Zero-copy access for consumers. Fill span[0] with the used bytes
+ * from the tail pointer towards the end of the internal buffer, and
+ * span[1] with the bytes that wrapped around to its start (len 0 if
+ * none). Returns the total number of bytes described, which is the
+ * same as ringbuf_bytes_used.
+ *
+ * The ring buffer is not modified; call ringbuf_consume once the
+ * bytes have been used.
+ */
+size_t
+ringbuf_peek(const struct ringbuf_t *rb, struct ringbuf_span span[2]);
+
+/*
+ * Drop count bytes from the tail of the ring buffer, typically after
+ * a ringbuf_peek. If count is greater than the number of bytes used,
+ * nothing is dropped and the function returns 0; otherwise it returns
+ * the new tail pointer.
+ */
+void *
+ringbuf_consume(ringbuf_t rb, size_t count);
+
+/*
+ * Zero-copy access for producers. Fill span[0] with the free bytes
+ * from the head pointer towards the end of the internal buffer, and
+ * span[1] with the free bytes at its start (len 0 if none). Returns
+ * the total number of bytes described, which is the same as
+ * ringbuf_bytes_free.
+ *
+ * The ring buffer is not modified; write into the spans in order and
+ * call ringbuf_commit with the number of bytes written.
+ */
+size_t
+ringbuf_reserve(ringbuf_t rb, struct ringbuf_span span[2]);
+
+/*
+ * Publish count bytes written at the head of the ring buffer, typically
+ * after a ringbuf_reserve. Unlike ringbuf_memcpy_into this never
+ * overflows: if count is greater than the number of free bytes,
+ * nothing is committed and the function returns 0; otherwise it
+ * returns the new head pointer.
+ */
+void *
+ringbuf_commit(ringbuf_t rb, size_t count);
+
+/*
+ * Single-producer/single-consumer access.
+ *
+ * One context (e.g. the UART RX interrupt) may call ringbuf_spsc_put
+ * while another (e.g. user_procTask) calls ringbuf_spsc_get on the same
+ * ring buffer, without any locking or disabling of interrupts. The
+ * producer only ever moves the head and the consumer only ever moves
+ * the tail; each publishes its counter with release semantics after
+ * the data it covers has been written or read, and reads the other
+ * side's counter with acquire semantics.
+ *
+ * None of the other ringbuf_* functions that modify the ring buffer
+ * may be used while both sides are active. In particular
+ * ringbuf_memcpy_into moves the tail on overflow.
+ */
+
+/*
+ * Producer side. Copy up to count bytes from src into the ring buffer.
+ * Unlike ringbuf_memcpy_into this never overwrites unread data: if
+ * there is not enough room, only the bytes that fit are copied. Returns
+ * the number of bytes copied.
+ */
+size_t
+ringbuf_spsc_put(ringbuf_t dst, const void *src, size_t count);
+
+/*
+ * Consumer side. Copy up to count bytes from the ring buffer into dst
+ * and remove them from the ring buffer. Returns the number of bytes
+ * copied, which may be less than count if fewer were available.
+ */
+size_t
+ringbuf_spsc_get(void *dst, ringbuf_t src, size_t count);
+
 #endif /* INCLUDED_RINGBUF_H */
 
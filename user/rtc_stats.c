@@ -0,0 +1,65 @@
+#include <stddef.h>
+
+#include "c_types.h"
+#include "osapi.h"
+#include "user_interface.h"
+
+#include "user_config.h"
+#include "rtc_stats.h"
+
+/*
+ * The totals are kept in RTC user memory with a checksum over them, the
+ * same way as the MAC bag. RTC memory is not cleared by a restart, but
+ * holds garbage after a power cycle, which the checksum catches.
+ */
+#define RTC_STATS_MAGIC 0x73746174
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t reserved;
+  rtc_stats_t stats;
+  uint32_t check; // Over everything above
+} rtc_stats_rec_t;
+
+static uint32_t ICACHE_FLASH_ATTR
+rtc_stats_check(const rtc_stats_rec_t *rec)
+{
+  const uint32_t *w = (const uint32_t *)rec;
+  uint32_t check = RTC_STATS_MAGIC;
+  uint8_t i;
+
+  for (i = 0; i < offsetof(rtc_stats_rec_t, check) / 4; i++)
+  {
+    check = ((check << 5) | (check >> 27)) ^ w[i];
+  }
+  return check;
+}
+
+bool ICACHE_FLASH_ATTR
+rtc_stats_load(rtc_stats_t *stats)
+{
+  rtc_stats_rec_t rec;
+
+  if (!system_rtc_mem_read(RTC_STATS_ADDR, &rec, sizeof(rec)) ||
+      rec.magic != RTC_STATS_MAGIC || rec.check != rtc_stats_check(&rec))
+  {
+    os_memset(stats, 0, sizeof(*stats));
+    return false;
+  }
+  *stats = rec.stats;
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+rtc_stats_save(const rtc_stats_t *stats)
+{
+  rtc_stats_rec_t rec;
+
+  // No padding may go into the checksum uninitialised
+  os_memset(&rec, 0, sizeof(rec));
+  rec.magic = RTC_STATS_MAGIC;
+  rec.stats = *stats;
+  rec.check = rtc_stats_check(&rec);
+  system_rtc_mem_write(RTC_STATS_ADDR, &rec, sizeof(rec));
+}
@@ -0,0 +1,27 @@
+#ifndef _RTC_STATS_H_
+#define _RTC_STATS_H_
+
+#include "c_types.h"
+
+// Totals since power on, over all restarts
+typedef struct
+{
+  uint32_t boots; // Restarts, the first boot included
+  uint32_t cycles; // StreetPass MAC cycles
+  uint64_t uptime_us;
+  uint64_t bytes_in, bytes_out;
+  uint32_t packets_in, packets_out;
+  uint32_t ap_watchdog_resets, client_watchdog_resets;
+  // Only about the last restart: 1 if the AP watchdog caused it, 2 if
+  // the client watchdog did, 0 if neither, and that watchdog's timeout
+  uint32_t watchdog_reset, watchdog_reset_s;
+} rtc_stats_t;
+
+// Reads the totals kept in RTC memory. After a power cycle there are
+// none, stats is zeroed and false is returned.
+bool rtc_stats_load(rtc_stats_t *stats);
+
+// Keeps the totals in RTC memory for the next boot
+void rtc_stats_save(const rtc_stats_t *stats);
+
+#endif
@@ -0,0 +1,97 @@
+#include "c_types.h"
+#include "osapi.h"
+
+#include "sta_stats.h"
+
+/*
+ * Open addressing with linear probing over a fixed array, so counting a
+ * frame is a hash and at most STA_STATS_PROBES compares, and nothing is
+ * ever allocated. Entries are never removed, only replaced: when all the
+ * probed slots are taken, the station seen longest ago gives up its slot.
+ * As no slot ever becomes free again, a lookup may stop at the first free
+ * one.
+ */
+static sta_stats_t sta_table[STA_STATS_SLOTS];
+
+// Fails to compile if MAX_CLIENTS outgrows STA_STATS_POW2()
+typedef char sta_stats_slots_check[STA_STATS_SLOTS >= 2 * MAX_CLIENTS ?
+                                   1 : -1];
+
+static uint8_t ICACHE_FLASH_ATTR
+sta_stats_hash(const uint8_t *mac)
+{
+  // The vendor part is the same for most consoles, so use the rest
+  return (mac[3] ^ mac[4] ^ mac[5]) & (STA_STATS_SLOTS - 1);
+}
+
+static sta_stats_t * ICACHE_FLASH_ATTR
+sta_stats_slot(const uint8_t *mac, bool add, uint32_t now)
+{
+  uint8_t slot = sta_stats_hash(mac);
+  sta_stats_t *oldest = NULL;
+  sta_stats_t *sta;
+  uint8_t i;
+
+  for (i = 0; i < STA_STATS_PROBES; i++)
+  {
+    sta = &sta_table[(slot + i) & (STA_STATS_SLOTS - 1)];
+    if (!sta->used)
+    {
+      oldest = sta;
+      break;
+    }
+    if (os_memcmp(sta->mac, mac, 6) == 0)
+    {
+      return sta;
+    }
+    if (oldest == NULL || now - sta->last_seen > now - oldest->last_seen)
+    {
+      oldest = sta;
+    }
+  }
+
+  if (!add)
+  {
+    return NULL;
+  }
+  os_memset(oldest, 0, sizeof(*oldest));
+  os_memcpy(oldest->mac, mac, 6);
+  oldest->used = 1;
+  return oldest;
+}
+
+void ICACHE_FLASH_ATTR
+sta_stats_count(const uint8_t *mac, uint16_t len, bool in, uint32_t now)
+{
+  sta_stats_t *sta;
+
+  if (mac[0] & 1)
+  {
+    return;
+  }
+
+  sta = sta_stats_slot(mac, true, now);
+  sta->last_seen = now;
+  if (in)
+  {
+    sta->bytes_in += len;
+    sta->packets_in++;
+  }
+  else
+  {
+    sta->bytes_out += len;
+    sta->packets_out++;
+  }
+}
+
+sta_stats_t * ICACHE_FLASH_ATTR
+sta_stats_find(const uint8_t *mac)
+{
+  return sta_stats_slot(mac, false, 0);
+}
+
+sta_stats_t * ICACHE_FLASH_ATTR
+sta_stats_get(uint8_t i)
+{
+  return i < STA_STATS_SLOTS && sta_table[i].used ? &sta_table[i] : NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef _STA_STATS_H_
+#define _STA_STATS_H_
+
+#include "c_types.h"
+#include "user_config.h"
+
+// Slots in the table: twice MAX_CLIENTS, for the stations that have left
+// since, rounded up to a power of two for the hash
+#define STA_STATS_POW2(n) ((n) <= 4 ? 4 : (n) <= 8 ? 8 : (n) <= 16 ? 16 : \
+                           (n) <= 32 ? 32 : 64)
+#define STA_STATS_SLOTS STA_STATS_POW2(2 * MAX_CLIENTS)
+// Slots looked at for one MAC, which bounds the work per frame
+#define STA_STATS_PROBES 4
+
+typedef struct
+{
+  uint8_t mac[6];
+  uint16_t used;
+  uint32_t last_seen; // Seconds since boot
+  uint32_t packets_in, packets_out;
+  uint64_t bytes_in, bytes_out;
+} sta_stats_t;
+
+// Counts a frame from (in) or to a station. Group addresses are ignored.
+void sta_stats_count(const uint8_t *mac, uint16_t len, bool in, uint32_t now);
+
+// Returns the entry of a station, or NULL if it has not been seen
+sta_stats_t *sta_stats_find(const uint8_t *mac);
+
+// Returns the entry in slot i, or NULL if the slot is free
+sta_stats_t *sta_stats_get(uint8_t i);
+
+#endif
@@ -0,0 +1,65 @@
+#include "c_types.h"
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+
+#include "task_post.h"
+
+/*
+ * A flag per signal rather than a bit mask: the interrupt sets it and
+ * the task clears it, each with a single byte store. The task clears it
+ * before looking at the data, so whatever the interrupt adds after that
+ * comes with a new post. Testing and setting the flag, and the counts,
+ * are read-modify-write, so the task does them with interrupts off.
+ */
+task_stats_t task_stats;
+static volatile uint8_t task_pending[TASK_SIGNALS];
+static volatile os_param_t task_pending_par[TASK_SIGNALS];
+
+// Not in flash, called from the UART interrupt
+bool
+task_post_intr(os_signal_t sig, os_param_t par)
+{
+  if (sig < TASK_SIGNALS)
+  {
+    if (task_pending[sig] && task_pending_par[sig] == par)
+    {
+      task_stats.coalesced++;
+      return true;
+    }
+    task_pending[sig] = 1;
+    task_pending_par[sig] = par;
+  }
+
+  if (!system_os_post(user_procTaskPrio, sig, par))
+  {
+    if (sig < TASK_SIGNALS)
+    {
+      task_pending[sig] = 0;
+    }
+    task_stats.dropped++;
+    return false;
+  }
+  task_stats.posted++;
+  return true;
+}
+
+bool ICACHE_FLASH_ATTR
+task_post(os_signal_t sig, os_param_t par)
+{
+  bool posted;
+
+  ETS_INTR_LOCK();
+  posted = task_post_intr(sig, par);
+  ETS_INTR_UNLOCK();
+  return posted;
+}
+
+void ICACHE_FLASH_ATTR
+task_taken(os_signal_t sig)
+{
+  if (sig < TASK_SIGNALS)
+  {
+    task_pending[sig] = 0;
+  }
+}
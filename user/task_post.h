@@ -0,0 +1,36 @@
+#ifndef _TASK_POST_H_
+#define _TASK_POST_H_
+
+#include "c_types.h"
+#include "os_type.h"
+#include "user_config.h"
+
+#define user_procTaskPrio 0
+#define user_procTaskQueueLen 8
+
+// Signals coalesced one by one, see USER_SIGNALS
+#define TASK_SIGNALS (SIG_GPIO_INT + 1)
+
+typedef struct
+{
+  uint32_t posted;
+  uint32_t coalesced; // Already pending with the same parameter
+  uint32_t dropped; // The queue was full
+} task_stats_t;
+
+extern task_stats_t task_stats;
+
+/*
+ * Posts sig to user_procTask, unless it is still pending with the same
+ * parameter: the handlers drain whatever has piled up, so one wake-up
+ * does for many posts. For task context, it locks out interrupts.
+ */
+bool task_post(os_signal_t sig, os_param_t par);
+
+// The same, for the UART interrupt, which must not take the lock
+bool task_post_intr(os_signal_t sig, os_param_t par);
+
+// Called by user_procTask for each event, before handling it
+void task_taken(os_signal_t sig);
+
+#endif
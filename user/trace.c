@@ -0,0 +1,52 @@
+#include "c_types.h"
+#include "osapi.h"
+#include "user_interface.h"
+
+#include "trace.h"
+
+/*
+ * A ring of fixed-size binary records, each written with one store per
+ * field, so tracing costs about as much as incrementing a counter and
+ * nothing is formatted until the trace is dumped. The newest records
+ * overwrite the oldest ones.
+ */
+const char *trace_event_name[TRACE_EVENTS] =
+  {"boot", "STA connected", "STA disconnected", "STA got IP",
+   "STA DHCP timeout", "station join", "station leave", "MAC rotate",
+   "AP on", "AP off", "watchdog"};
+
+static trace_rec_t trace_ring[TRACE_RECORDS];
+static uint32_t trace_next;
+
+void ICACHE_FLASH_ATTR
+trace(TRACE_EVENT event, uint16_t arg0, uint32_t arg1)
+{
+  trace_rec_t *rec = &trace_ring[trace_next & (TRACE_RECORDS - 1)];
+
+  rec->time = system_get_time();
+  rec->event = event;
+  rec->arg0 = arg0;
+  rec->arg1 = arg1;
+  trace_next++;
+}
+
+void ICACHE_FLASH_ATTR
+trace_range(uint32_t *first, uint32_t *next)
+{
+  *next = trace_next;
+  *first = trace_next > TRACE_RECORDS ? trace_next - TRACE_RECORDS : 0;
+}
+
+bool ICACHE_FLASH_ATTR
+trace_get(uint32_t seq, trace_rec_t *rec)
+{
+  uint32_t first, next;
+
+  trace_range(&first, &next);
+  if (seq < first || seq >= next)
+  {
+    return false;
+  }
+  *rec = trace_ring[seq & (TRACE_RECORDS - 1)];
+  return true;
+}
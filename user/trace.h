@@ -0,0 +1,53 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "c_types.h"
+
+// Records kept, a power of two
+#define TRACE_RECORDS 128
+// Records "show trace" prints at a time, so a page fits the console
+// buffer
+#define TRACE_DUMP_PAGE 24
+
+typedef enum {TRACE_BOOT, TRACE_STA_CONNECTED, TRACE_STA_DISCONNECTED,
+              TRACE_STA_GOT_IP, TRACE_STA_DHCP_TIMEOUT, TRACE_AP_STA_JOIN,
+              TRACE_AP_STA_LEAVE, TRACE_MAC_ROTATE, TRACE_AP_ON, TRACE_AP_OFF,
+              TRACE_WATCHDOG, TRACE_EVENTS} TRACE_EVENT;
+
+/*
+ * The arguments of each event:
+ *   TRACE_BOOT               -, -
+ *   TRACE_STA_CONNECTED      channel, -
+ *   TRACE_STA_DISCONNECTED   reason, -
+ *   TRACE_STA_GOT_IP         -, IP address
+ *   TRACE_STA_DHCP_TIMEOUT   -, -
+ *   TRACE_AP_STA_JOIN        AID, last 4 bytes of the MAC
+ *   TRACE_AP_STA_LEAVE       AID, last 4 bytes of the MAC
+ *   TRACE_MAC_ROTATE         MAC index, 1 if a new AP window starts
+ *   TRACE_AP_ON              MAC index, -
+ *   TRACE_AP_OFF             -, -
+ *   TRACE_WATCHDOG           0 for AP, 1 for client watchdog, timeout
+ *
+ * TRACE_WATCHDOG is recorded after TRACE_BOOT, for the watchdog that
+ * caused the restart into this boot.
+ */
+typedef struct
+{
+  uint32_t time; // system_get_time()
+  uint16_t event;
+  uint16_t arg0;
+  uint32_t arg1;
+} trace_rec_t;
+
+extern const char *trace_event_name[TRACE_EVENTS];
+
+void trace(TRACE_EVENT event, uint16_t arg0, uint32_t arg1);
+
+// Copies the record with sequence number seq, counted from the first one
+// since boot. Returns false if it has been overwritten or not written yet.
+bool trace_get(uint32_t seq, trace_rec_t *rec);
+
+// Sequence numbers of the oldest record still kept and of the next one
+void trace_range(uint32_t *first, uint32_t *next);
+
+#endif
@@ -22,6 +22,25 @@
 //
 #define STATUS_LED_GPIO	2
 
+//
+// RTC user memory (in 4 byte blocks, from 64 on) that is kept across
+// restarts, but not across power cycles
+//
+#define RTC_MAC_BAG_ADDR 64
+#define RTC_STATS_ADDR 76
+
+//
+// Define this to time the netif hooks with the cycle counter, for
+// "show latency". Off by default, it costs every forwarded packet.
+//
+//#define LATENCY_STATS 1
+
+//
+// Define this to account CPU time per context, for "show cpu". Off by
+// default, it costs every forwarded packet.
+//
+//#define CPU_STATS 1
+
 //
 // Define this to support the setting of the WiFi PHY mode
 //
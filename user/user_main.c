@@ -1,3 +1,6 @@
+#include <stddef.h>
+#include <stdarg.h>
+
 #include "c_types.h"
 #include "mem.h"
 #include "ets_sys.h"
@@ -20,26 +23,68 @@
 #include "user_config.h"
 #include "config_flash.h"
 #include "sys_time.h"
+#include "mac_bag.h"
+#include "rtc_stats.h"
+#include "sta_stats.h"
+#include "latency.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include "cpu_stats.h"
+#include "task_post.h"
+#include "jobs.h"
+#include "watchdog.h"
 
 #include "easygpio.h"
 
 /* System Task, for signals refer to user_config.h */
-#define user_procTaskPrio 0
-#define user_procTaskQueueLen 1
 os_event_t user_procTaskQueue[user_procTaskQueueLen];
 static void user_procTask(os_event_t *events);
 
-static os_timer_t ptimer;
+static job_t second_job, led_job, ip_config_job;
 
-int32_t ap_watchdog_cnt;
-int32_t client_watchdog_cnt;
+// Reset when the uplink or the clients have gone quiet
+static watchdog_t ap_watchdog, client_watchdog;
 int32_t awake_cnt = 0;
 int32_t ap_enabled_cnt = 0;
+int32_t mac_dwell_cnt = 0;
 
 /* Some stats */
 uint64_t Bytes_in, Bytes_out, Bytes_in_last, Bytes_out_last;
 uint32_t Packets_in, Packets_out, Packets_in_last, Packets_out_last;
 uint64_t t_old;
+static uint32_t uptime_s;
+
+/*
+ * Rates over the last second, their moving average and peak. The average
+ * is kept scaled by 2^RATE_EWMA_SHIFT, the way TCP keeps its smoothed RTT,
+ * so it moves by 1/2^RATE_EWMA_SHIFT of the difference each second
+ * without losing the fraction.
+ */
+#define RATE_EWMA_SHIFT 3
+typedef struct
+{
+  uint32_t now;
+  uint32_t avg_scaled;
+  uint32_t peak;
+} rate_t;
+static rate_t rate_bytes_in, rate_bytes_out, rate_packets_in, rate_packets_out;
+
+/* Totals of the earlier boots since power on, kept in RTC memory */
+static rtc_stats_t stats_before;
+
+/* Time since reset at which each boot phase was reached, for "show boot" */
+typedef enum {BOOT_USER_INIT, BOOT_CONFIG_LOADED, BOOT_INIT_DONE, BOOT_AP_UP,
+              BOOT_STA_CONNECTED, BOOT_STA_GOT_IP, BOOT_PHASES} BOOT_PHASE;
+static const char *boot_phase_name[BOOT_PHASES] =
+  {"user_init", "config loaded", "init done", "AP up", "STA connected",
+   "STA got IP"};
+static uint32_t boot_phase_us[BOOT_PHASES];
+static uint8_t boot_phases_reached;
+
+/* In-place StreetPass MAC rotations, instead of a restart per cycle */
+static uint32_t mac_rotations;
+static uint32_t mac_rotation_start_us, mac_rotation_ap_up_us;
+static bool mac_rotation_pending;
 
 /* Hold the system wide configuration */
 sysconfig_t config;
@@ -59,26 +104,144 @@ uint8_t remote_console_disconnect;
 struct espconn *currentconn;
 
 void ICACHE_FLASH_ATTR user_set_softap_wifi_config(void);
-void ICACHE_FLASH_ATTR user_set_softap_ip_config(void);
+bool ICACHE_FLASH_ATTR user_set_softap_ip_config(void);
 void ICACHE_FLASH_ATTR user_set_station_config(void);
 
-uint8_t current_mac_address_index = 0;;
+uint8_t current_mac_address_index = 0;
+
+void
+ICACHE_FLASH_ATTR boot_phase(BOOT_PHASE phase)
+{
+  if (!(boot_phases_reached & (1 << phase)))
+  {
+    boot_phase_us[phase] = system_get_time();
+    boot_phases_reached |= 1 << phase;
+  }
+}
+
+void
+ICACHE_FLASH_ATTR rate_update(rate_t *rate, uint32_t count, uint32_t t_diff)
+{
+  rate->now = (uint32_t)((uint64_t)count * 1000000 / t_diff);
+  rate->avg_scaled += rate->now - (rate->avg_scaled >> RATE_EWMA_SHIFT);
+  if (rate->now > rate->peak)
+  {
+    rate->peak = rate->now;
+  }
+}
+
+// Totals since power on, this boot included
+void
+ICACHE_FLASH_ATTR stats_total(rtc_stats_t *total)
+{
+  total->boots = stats_before.boots + 1;
+  // Every boot starts a cycle with a new MAC, so does every rotation
+  total->cycles = stats_before.cycles + 1 + mac_rotations;
+  total->uptime_us = stats_before.uptime_us + get_long_systime();
+  total->bytes_in = stats_before.bytes_in + Bytes_in;
+  total->bytes_out = stats_before.bytes_out + Bytes_out;
+  total->packets_in = stats_before.packets_in + Packets_in;
+  total->packets_out = stats_before.packets_out + Packets_out;
+  total->ap_watchdog_resets = stats_before.ap_watchdog_resets;
+  total->client_watchdog_resets = stats_before.client_watchdog_resets;
+  total->watchdog_reset = 0;
+  total->watchdog_reset_s = 0;
+}
+
+void
+ICACHE_FLASH_ATTR stats_save(void)
+{
+  rtc_stats_t total;
+
+  stats_total(&total);
+  rtc_stats_save(&total);
+}
 
-int
-ICACHE_FLASH_ATTR random_mac_index()
+// The last 4 bytes of a MAC, enough to tell stations apart in a trace
+uint32_t
+ICACHE_FLASH_ATTR trace_mac(const uint8_t *mac)
 {
-  return rand() % sizeof(config.mac_list) / sizeof(config.mac_list[0]);
+  return (mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5];
 }
 
+void console_send_response(struct espconn *pespconn, uint8_t do_cmd);
+
+// Printf from ROM, hands each character to print_function
+int ets_vprintf(int (*print_function)(int), const char *format, va_list arg);
+
+/*
+ * Console output goes straight into console_tx_buffer. When it is full
+ * it is sent out right away to the connection of the current command:
+ * the task is not preempted, so a posted SIG_CONSOLE_TX could only run
+ * after the whole output was written.
+ */
 void
 ICACHE_FLASH_ATTR to_console(char *str)
 {
-  ringbuf_memcpy_into(console_tx_buffer, str, os_strlen(str));
+  size_t len = os_strlen(str);
+
+  if (ringbuf_bytes_free(console_tx_buffer) < len)
+  {
+    console_send_response(currentconn, false);
+  }
+  ringbuf_memcpy_into(console_tx_buffer, str, len);
+}
+
+static int
+ICACHE_FLASH_ATTR console_putc(int c)
+{
+  char ch = c;
+
+  if (ringbuf_is_full(console_tx_buffer))
+  {
+    console_send_response(currentconn, false);
+  }
+  ringbuf_memcpy_into(console_tx_buffer, &ch, 1);
+  return c;
+}
+
+void
+ICACHE_FLASH_ATTR console_printf(const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  ets_vprintf(console_putc, format, args);
+  va_end(args);
+}
+
+// The answer to a command, printed after an empty line
+void
+ICACHE_FLASH_ATTR console_reply(const char *format, ...)
+{
+  va_list args;
+
+  to_console("\r\n");
+  va_start(args, format);
+  ets_vprintf(console_putc, format, args);
+  va_end(args);
+}
+
+// Ends a "Station:" line of "show stats" with the traffic of the station
+void
+ICACHE_FLASH_ATTR console_sta_stats(sta_stats_t *sta)
+{
+  if (sta == NULL)
+  {
+    to_console("\r\n");
+    return;
+  }
+  console_printf(", %d/%d KiB in/out (%d/%d packets), seen %ds ago\r\n",
+                 (uint32_t)(sta->bytes_in/1024), (uint32_t)(sta->bytes_out/1024),
+                 sta->packets_in, sta->packets_out, uptime_s - sta->last_seen);
 }
 
 err_t ICACHE_FLASH_ATTR
 my_input_ap(struct pbuf *p, struct netif *inp)
 {
+  err_t err;
+  CPU_ENTER(cpu);
+  LATENCY_ENTER(stamp);
   //  os_printf("Got packet from STA\r\n");
 
   if (config.status_led <= 16)
@@ -86,17 +249,29 @@ my_input_ap(struct pbuf *p, struct netif *inp)
     easygpio_outputSet (config.status_led, 1);
   }
 
-  client_watchdog_cnt = config.client_watchdog;
+  watchdog_kick(&client_watchdog);
 
   Bytes_in += p->tot_len;
   Packets_in++;
+  if (p->len >= 12)
+  {
+    // Source MAC of the Ethernet frame
+    sta_stats_count((uint8_t *)p->payload + 6, p->tot_len, true, uptime_s);
+  }
 
-  orig_input_ap (p, inp);
+  LATENCY_ORIG(stamp);
+  err = orig_input_ap (p, inp);
+  LATENCY_EXIT(stamp, LATENCY_INPUT_AP);
+  CPU_EXIT(cpu, CPU_NETIF_AP);
+  return err;
 }
 
 err_t ICACHE_FLASH_ATTR
 my_output_ap(struct netif *outp, struct pbuf *p)
 {
+  err_t err;
+  CPU_ENTER(cpu);
+  LATENCY_ENTER(stamp);
   //  os_printf("Send packet to STA\r\n");
 
   if (config.status_led <= 16)
@@ -106,21 +281,46 @@ my_output_ap(struct netif *outp, struct pbuf *p)
 
   Bytes_out += p->tot_len;
   Packets_out++;
+  if (p->len >= 6)
+  {
+    // Destination MAC of the Ethernet frame
+    sta_stats_count((uint8_t *)p->payload, p->tot_len, false, uptime_s);
+  }
 
-  orig_output_ap (outp, p);
+  LATENCY_ORIG(stamp);
+  err = orig_output_ap (outp, p);
+  LATENCY_EXIT(stamp, LATENCY_OUTPUT_AP);
+  CPU_EXIT(cpu, CPU_NETIF_AP);
+  return err;
 }
 
 err_t ICACHE_FLASH_ATTR
 my_input_sta(struct pbuf *p, struct netif *inp)
 {
-  ap_watchdog_cnt = config.ap_watchdog;
-  orig_input_sta (p, inp);
+  err_t err;
+  CPU_ENTER(cpu);
+  LATENCY_ENTER(stamp);
+
+  watchdog_kick(&ap_watchdog);
+  LATENCY_ORIG(stamp);
+  err = orig_input_sta (p, inp);
+  LATENCY_EXIT(stamp, LATENCY_INPUT_STA);
+  CPU_EXIT(cpu, CPU_NETIF_STA);
+  return err;
 }
 
 err_t ICACHE_FLASH_ATTR
 my_output_sta(struct netif *outp, struct pbuf *p)
 {
-  orig_output_sta (outp, p);
+  err_t err;
+  CPU_ENTER(cpu);
+  LATENCY_ENTER(stamp);
+
+  LATENCY_ORIG(stamp);
+  err = orig_output_sta (outp, p);
+  LATENCY_EXIT(stamp, LATENCY_OUTPUT_STA);
+  CPU_EXIT(cpu, CPU_NETIF_STA);
+  return err;
 }
 
 static void ICACHE_FLASH_ATTR
@@ -238,27 +438,51 @@ parse_str_into_tokens(char *str, char **tokens, int max_tokens)
 void
 console_send_response(struct espconn *pespconn, uint8_t do_cmd)
 {
-  char payload[MAX_CON_SEND_SIZE+4];
-  uint16_t len = ringbuf_bytes_used(console_tx_buffer);
-
-  ringbuf_memcpy_from(payload, console_tx_buffer, len);
-
-  if (do_cmd)
-  {
-    os_memcpy(&payload[len], "CMD>", 4);
-    len += 4;
-  }
+  struct ringbuf_span span[2];
+  uint16_t len = ringbuf_peek(console_tx_buffer, span);
 
   if (pespconn != NULL)
   {
-    espconn_sent(pespconn, payload, len);
+    // espconn_sent() takes a single buffer, so only gather the response
+    // into one if it wraps around or needs the prompt appended
+    if (span[1].len == 0 && !do_cmd)
+    {
+      espconn_sent(pespconn, span[0].base, len);
+    }
+    else
+    {
+      uint8_t *payload = (uint8_t *)mem_alloc(MEM_CONSOLE, len + 4);
+
+      if (payload != NULL)
+      {
+        os_memcpy(payload, span[0].base, span[0].len);
+        os_memcpy(&payload[span[0].len], span[1].base, span[1].len);
+        if (do_cmd)
+        {
+          os_memcpy(&payload[len], "CMD>", 4);
+        }
+        espconn_sent(pespconn, payload, len + (do_cmd ? 4 : 0));
+        mem_free(MEM_CONSOLE, payload);
+      }
+    }
   }
   else
   {
-    UART_Send(0, &payload, len);
+    // Send straight from the ring buffer
+    UART_Send(0, (char *)span[0].base, span[0].len);
+    UART_Send(0, (char *)span[1].base, span[1].len);
+    if (do_cmd)
+    {
+      UART_Send(0, "CMD>", 4);
+    }
   }
+
+  ringbuf_consume(console_tx_buffer, len);
 }
 
+// From c_functions/missing.c
+char *_strcat(char *dest, const char *src);
+
 // Use this from ROM instead
 int ets_str2macaddr(uint8 *mac, char *str_mac);
 #define parse_mac ets_str2macaddr
@@ -283,686 +507,1172 @@ int i;
 static char INVALID_NUMARGS[] = "Invalid number of arguments\r\n";
 static char INVALID_ARG[] = "Invalid argument\r\n";
 
-void ICACHE_FLASH_ATTR
-console_handle_command(struct espconn *pespconn)
+/*
+ * The console is driven by tables sorted by name, looked up with a binary
+ * search: the commands, the "show" subcommands and the parameters of
+ * "set". The tables stay in RAM, flash could only be read 32 bits at a
+ * time and the names are compared byte by byte.
+ */
+
+// How a command handler has answered
+typedef enum {
+  CMD_DONE, // It has written its output to the console already
+  CMD_INVALID // Not at all, the command is unknown
+} CMD_RESULT;
+
+typedef CMD_RESULT (*console_handler_t)(int nTokens, char **tokens);
+
+typedef struct
 {
-  #define MAX_CMD_TOKENS 20
+  const char *name; // Must come first, see console_lookup()
+  console_handler_t handler;
+} console_cmd_t;
 
-  char cmd_line[MAX_CON_CMD_SIZE+1];
-  char response[1024];
-  char *tokens[MAX_CMD_TOKENS];
+typedef enum {PARAM_STRING, PARAM_INT, PARAM_IP, PARAM_MAC} PARAM_TYPE;
+
+typedef union
+{
+  int32_t i;
+  ip_addr_t ip;
+  uint8_t mac[6];
+  char str[64];
+} param_value_t;
 
-  int bytes_count, nTokens;
+// Offset of a parameter that is not kept in sysconfig_t
+#define PARAM_NO_FIELD 0xffff
 
-  bytes_count = ringbuf_bytes_used(console_rx_buffer);
-  ringbuf_memcpy_from(cmd_line, console_rx_buffer, bytes_count);
+typedef struct
+{
+  const char *name; // Must come first, see console_lookup()
+  uint8_t type;
+  uint8_t size; // Of the sysconfig_t field
+  uint16_t offset; // Of the sysconfig_t field
+  int32_t min, max; // Bounds of a PARAM_INT
+  const char *keyword; // Taken instead of a value, like "none" or "dhcp"
+  int32_t keyword_value; // What the keyword stands for
+  // Side effects of the new value, before it is stored; false rejects it
+  bool (*apply)(param_value_t *value);
+} console_param_t;
+
+#define PARAM_FIELD(f) sizeof(((sysconfig_t *)0)->f), offsetof(sysconfig_t, f)
+#define PARAM_STR(name, f, apply) \
+  {name, PARAM_STRING, PARAM_FIELD(f), 0, 0, NULL, 0, apply}
+#define PARAM_INT(name, f, min, max, keyword, keyword_value, apply) \
+  {name, PARAM_INT, PARAM_FIELD(f), min, max, keyword, keyword_value, apply}
+#define PARAM_IP(name, f, keyword, apply) \
+  {name, PARAM_IP, PARAM_FIELD(f), 0, 0, keyword, 0, apply}
+#define PARAM_MAC(name, f, apply) \
+  {name, PARAM_MAC, PARAM_FIELD(f), 0, 0, NULL, 0, apply}
+
+static bool ICACHE_FLASH_ATTR
+param_ap_mac(param_value_t *value)
+{
+  return wifi_set_macaddr(SOFTAP_IF, value->mac);
+}
 
-  cmd_line[bytes_count] = 0;
-  response[0] = 0;
+static bool ICACHE_FLASH_ATTR
+param_ap_watchdog(param_value_t *value)
+{
+  watchdog_set(&ap_watchdog, value->i);
+  return true;
+}
 
-  nTokens = parse_str_into_tokens(cmd_line, tokens, MAX_CMD_TOKENS);
+static bool ICACHE_FLASH_ATTR
+param_client_watchdog(param_value_t *value)
+{
+  watchdog_set(&client_watchdog, value->i);
+  return true;
+}
 
-  if (nTokens == 0)
+static bool ICACHE_FLASH_ATTR
+param_dns(param_value_t *value)
+{
+  if (value->ip.addr)
   {
-    char c = '\n';
-    ringbuf_memcpy_into(console_tx_buffer, &c, 1);
-    goto command_handled_2;
+    dns_ip.addr = value->ip.addr;
+    dhcps_set_DNS(&dns_ip);
   }
+  return true;
+}
 
-  if (strcmp(tokens[0], "help") == 0)
-  {
-    os_sprintf(response, "show [config|stats]\r\n");
-    to_console(response);
+static bool ICACHE_FLASH_ATTR
+param_mac_dwell(param_value_t *value)
+{
+  mac_dwell_cnt = 0;
+  return true;
+}
+
+static bool ICACHE_FLASH_ATTR
+param_network(param_value_t *value)
+{
+  // Always a /24
+  ip4_addr4(&value->ip) = 0;
+  return true;
+}
 
-    os_sprintf(response, "set [ssid|password|auto_connect|ap_ssid] <val>\r\nset [sta_mac|sta_hostname] <val>\r\nset [dns|ip|netmask|gw] <val>\r\n");
-    to_console(response);
-    os_sprintf(response, "set [speed|status_led|config_port] <val>\r\nsave [config|dhcp]\r\nconnect | disconnect| reset [factory] | quit\r\n");
-    to_console(response);
-    os_sprintf(response, "set [client_watchdog|ap_watchdog] <val>\r\n");
-    to_console(response);
 #ifdef PHY_MODE
-    os_sprintf(response, "set phy_mode [1|2|3]\r\n");
-    to_console(response);
+static bool ICACHE_FLASH_ATTR
+param_phy_mode(param_value_t *value)
+{
+  return wifi_set_phy_mode(value->i);
+}
 #endif
 
-    goto command_handled_2;
+static bool ICACHE_FLASH_ATTR
+param_speed(param_value_t *value)
+{
+  if (!system_update_cpu_freq(value->i))
+  {
+    return false;
   }
+  // Cycles at the old clock would be misread at the new one
+  cpu_stats_clear();
+  return true;
+}
+
+static bool ICACHE_FLASH_ATTR
+param_ssid(param_value_t *value)
+{
+  config.auto_connect = 1;
+  return true;
+}
 
-  if (strcmp(tokens[0], "mac_list") == 0)
+static bool ICACHE_FLASH_ATTR
+param_status_led(param_value_t *value)
+{
+  if (config.status_led <= 16)
   {
-    // List stored HomePass mac addresses
-    int16_t i;
+    easygpio_outputSet (config.status_led, 1);
+  }
+  if (config.status_led == 1)
+  {
+    // Enable output if serial pin was used as status LED
+    system_set_os_print(1);
+  }
+  if (value->i <= 16)
+  {
+    if (value->i == 1)
+    {
+      // Disable output if serial pin is used as status LED
+      system_set_os_print(0);
+    }
+    easygpio_pinMode(value->i, EASYGPIO_NOPULL, EASYGPIO_OUTPUT);
+    easygpio_outputSet (value->i, 0);
+    job_start(&led_job, 100, 0);
+  }
+  else
+  {
+    // No LED, no need to wake up for it
+    job_stop(&led_job);
+  }
+  return true;
+}
 
-    to_console("HomePass mac list:\r\n");
-    for (i = 0; i <= MAC_LIST_LENGTH - 1; i++)
+// Sorted by name
+static const console_param_t console_params[] =
+{
+  {"ap_mac", PARAM_MAC, 6, PARAM_NO_FIELD, 0, 0, NULL, 0, param_ap_mac},
+  PARAM_STR("ap_ssid", ap_ssid, NULL),
+  PARAM_INT("ap_watchdog", ap_watchdog, 30, 0x7fffffff, "none", -1,
+            param_ap_watchdog),
+  PARAM_INT("auto_connect", auto_connect, 0, 1, NULL, 0, NULL),
+  PARAM_MAC("bssid", bssid, NULL),
+  PARAM_INT("client_watchdog", client_watchdog, 30, 0x7fffffff, "none", -1,
+            param_client_watchdog),
+  PARAM_IP("dns", dns_addr, "dhcp", param_dns),
+  PARAM_IP("gw", my_gw, NULL, NULL),
+  PARAM_IP("ip", my_addr, "dhcp", NULL),
+  PARAM_INT("mac_dwell", mac_dwell, 0, 0x7fffffff, NULL, 0, param_mac_dwell),
+  PARAM_IP("netmask", my_netmask, NULL, NULL),
+  PARAM_IP("network", network_addr, NULL, param_network),
+  PARAM_STR("password", password, NULL),
+#ifdef PHY_MODE
+  PARAM_INT("phy_mode", phy_mode, 1, 3, NULL, 0, param_phy_mode),
+#endif
+  PARAM_INT("speed", clock_speed, 80, 160, NULL, 0, param_speed),
+  PARAM_STR("ssid", ssid, param_ssid),
+  PARAM_STR("sta_hostname", sta_hostname, NULL),
+  PARAM_MAC("sta_mac", STA_MAC_address, NULL),
+  PARAM_INT("status_led", status_led, 0, 0xffff, NULL, 0, param_status_led),
+};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+// Finds name in a table sorted by name, with the name first in each entry
+static const void * ICACHE_FLASH_ATTR
+console_lookup(const void *table, uint16_t n, uint16_t size, const char *name)
+{
+  uint16_t lo = 0, hi = n;
+
+  while (lo < hi)
+  {
+    uint16_t mid = (lo + hi) / 2;
+    const void *entry = (const uint8_t *)table + mid * size;
+    int cmp = os_strcmp(name, *(const char * const *)entry);
+
+    if (cmp == 0)
+    {
+      return entry;
+    }
+    if (cmp < 0)
     {
-      os_sprintf(response, "%02x:%02x:%02x:%02x:%02x:%02x\r\n",
-                 config.mac_list[i][0], config.mac_list[i][1],
-                 config.mac_list[i][2], config.mac_list[i][3],
-                 config.mac_list[i][4], config.mac_list[i][5]);
-      to_console(response);
+      hi = mid;
     }
-    os_sprintf(response, "\r\n");
-    to_console(response);
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return NULL;
+}
 
-    goto command_handled_2;
+static int32_t ICACHE_FLASH_ATTR
+param_int_get(const console_param_t *param, const uint8_t *field)
+{
+  switch (param->size)
+  {
+    case 1:
+      return *field;
+    case 2:
+      return *(const uint16_t *)field;
+    default:
+      return *(const int32_t *)field;
   }
+}
 
-  if (strcmp(tokens[0], "show") == 0)
+// Writes the value of a parameter, kept at field, to out
+static void ICACHE_FLASH_ATTR
+param_format(const console_param_t *param, const uint8_t *field, char *out)
+{
+  switch (param->type)
   {
-    int16_t i;
-    ip_addr_t i_ip;
+    case PARAM_STRING:
+      os_sprintf(out, "%s", field);
+      break;
 
-    if (nTokens == 1 || (nTokens == 2 && strcmp(tokens[1], "config") == 0))
+    case PARAM_INT:
     {
-      os_sprintf(response,
-                 "Version %s (build: %s)\r\n",
+      int32_t i = param_int_get(param, field);
+
+      if (param->keyword != NULL && i == param->keyword_value)
+      {
+        os_sprintf(out, "%s", param->keyword);
+      }
+      else
+      {
+        os_sprintf(out, "%d", i);
+      }
+    } break;
+
+    case PARAM_IP:
+      if (param->keyword != NULL && ((const ip_addr_t *)field)->addr == 0)
+      {
+        os_sprintf(out, "%s", param->keyword);
+      }
+      else
+      {
+        os_sprintf(out, IPSTR, IP2STR((const ip_addr_t *)field));
+      }
+      break;
+
+    case PARAM_MAC:
+      os_sprintf(out, MACSTR, MAC2STR(field));
+      break;
+  }
+}
+
+// Parses the value of "set", from tokens[2] on, into value
+static bool ICACHE_FLASH_ATTR
+param_parse(const console_param_t *param, int nTokens, char **tokens,
+            param_value_t *value)
+{
+  int i;
+
+  os_memset(value, 0, sizeof(*value));
+  switch (param->type)
+  {
+    case PARAM_STRING:
+      // A value with spaces has been split over the remaining tokens,
+      // put them back together
+      for (i = 2; i < nTokens; i++)
+      {
+        if (os_strlen(value->str) + (i > 2) + os_strlen(tokens[i]) >=
+            param->size)
+        {
+          return false;
+        }
+        if (i > 2)
+        {
+          _strcat(value->str, " ");
+        }
+        _strcat(value->str, tokens[i]);
+      }
+      return true;
+
+    case PARAM_INT:
+      if (param->keyword != NULL && os_strcmp(tokens[2], param->keyword) == 0)
+      {
+        value->i = param->keyword_value;
+        return true;
+      }
+      value->i = atoi(tokens[2]);
+      return value->i >= param->min && value->i <= param->max;
+
+    case PARAM_IP:
+      if (param->keyword != NULL && os_strcmp(tokens[2], param->keyword) == 0)
+      {
+        value->ip.addr = 0;
+        return true;
+      }
+      value->ip.addr = ipaddr_addr(tokens[2]);
+      return true;
+
+    case PARAM_MAC:
+      return parse_mac(value->mac, tokens[2]);
+  }
+  return false;
+}
+
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_set(int nTokens, char **tokens)
+{
+  const console_param_t *param;
+  param_value_t value;
+  uint8_t *field;
+  char formatted[64];
+
+  /*
+   * For set commands atleast 2 tokens "set" "parameter" "value" is needed
+   * hence the check
+   */
+  if (nTokens < 3)
+  {
+    console_reply(INVALID_NUMARGS);
+    return CMD_DONE;
+  }
+
+  param = console_lookup(console_params, ARRAY_LEN(console_params),
+                         sizeof(console_params[0]), tokens[1]);
+  if (param == NULL)
+  {
+    return CMD_INVALID;
+  }
+  if (!param_parse(param, nTokens, tokens, &value))
+  {
+    console_reply(INVALID_ARG);
+    return CMD_DONE;
+  }
+  if (param->apply != NULL && !param->apply(&value))
+  {
+    console_reply("Setting %s failed\r\n", param->name);
+    return CMD_DONE;
+  }
+
+  if (param->offset == PARAM_NO_FIELD)
+  {
+    field = value.mac;
+  }
+  else
+  {
+    field = (uint8_t *)&config + param->offset;
+    switch (param->type)
+    {
+      case PARAM_STRING:
+        os_strcpy((char *)field, value.str);
+        break;
+
+      case PARAM_INT:
+        if (param->size == 1)
+        {
+          *field = value.i;
+        }
+        else if (param->size == 2)
+        {
+          *(uint16_t *)field = value.i;
+        }
+        else
+        {
+          *(int32_t *)field = value.i;
+        }
+        break;
+
+      default:
+        os_memcpy(field, &value, param->size);
+        break;
+    }
+  }
+
+  param_format(param, field, formatted);
+  console_reply("%s set to %s\r\n", param->name, formatted);
+  return CMD_DONE;
+}
+
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_config(int nTokens, char **tokens)
+{
+  uint8_t current_mac[6];
+
+  if (nTokens > 2)
+  {
+    return CMD_INVALID;
+  }
+
+  console_printf("Version %s (build: %s)\r\n",
                  ESPERPASS_VERSION, __TIMESTAMP__);
-      to_console(response);
 
-      os_sprintf(response, "STA: SSID:%s PW:%s%s\r\n",
+  console_printf("STA: SSID:%s PW:%s%s\r\n",
                  config.ssid,
                  (char*)config.password,
                  config.auto_connect?"":" [AutoConnect:0]");
-      to_console(response);
-      if (*(int*)config.bssid != 0)
-      {
-        os_sprintf(response, "BSSID: %02x:%02x:%02x:%02x:%02x:%02x\r\n",
-                   config.bssid[0], config.bssid[1], config.bssid[2],
-                   config.bssid[3], config.bssid[4], config.bssid[5]);
-        to_console(response);
-      }
+  if (os_memcmp(config.bssid, "\0\0\0\0\0", 6) != 0)
+  {
+    console_printf("BSSID: " MACSTR "\r\n", MAC2STR(config.bssid));
+  }
 
-      os_sprintf(response, "AP:  SSID:%s IP:%d.%d.%d.%d/24",
+  console_printf("AP:  SSID:%s IP:%d.%d.%d.%d/24",
                  config.ap_ssid,
                  IP2STR(&config.network_addr));
-      to_console(response);
 
-      // if static DNS, add it
-      os_sprintf(response,
-                 config.dns_addr.addr?" DNS: %d.%d.%d.%d\r\n":"\r\n",
+  // if static DNS, add it
+  console_printf(config.dns_addr.addr?" DNS: %d.%d.%d.%d\r\n":"\r\n",
                  IP2STR(&config.dns_addr));
-      to_console(response);
 
-      // if static IP, add it
-      os_sprintf(response,
-                 config.my_addr.addr?"Static IP: %d.%d.%d.%d Netmask: %d.%d.%d.%d Gateway: %d.%d.%d.%d\r\n":"",
+  // if static IP, add it
+  console_printf(config.my_addr.addr?"Static IP: %d.%d.%d.%d Netmask: %d.%d.%d.%d Gateway: %d.%d.%d.%d\r\n":"",
                  IP2STR(&config.my_addr), IP2STR(&config.my_netmask),
                  IP2STR(&config.my_gw));
-      to_console(response);
-
-      uint8_t current_mac[6];
-      wifi_get_macaddr(SOFTAP_IF, current_mac);
-      os_sprintf(response,
-                 "STA MAC: %02x:%02x:%02x:%02x:%02x:%02x\r\nAP MAC:  %02x:%02x:%02x:%02x:%02x:%02x\r\n",
-                 config.STA_MAC_address[0], config.STA_MAC_address[1],
-                 config.STA_MAC_address[2], config.STA_MAC_address[3],
-                 config.STA_MAC_address[4], config.STA_MAC_address[5],
-                 current_mac[0],
-                 current_mac[1],
-                 current_mac[2],
-                 current_mac[3],
-                 current_mac[4],
-                 current_mac[5]);
-      to_console(response);
-      os_sprintf(response, "STA hostname: %s\r\n", config.sta_hostname);
-      to_console(response);
-
-      os_sprintf(response, "Clock speed: %d\r\n", config.clock_speed);
-      to_console(response);
-
-      goto command_handled_2;
+
+  wifi_get_macaddr(SOFTAP_IF, current_mac);
+  console_printf("STA MAC: " MACSTR "\r\nAP MAC:  " MACSTR "\r\n",
+                 MAC2STR(config.STA_MAC_address), MAC2STR(current_mac));
+  console_printf("STA hostname: %s\r\n", config.sta_hostname);
+
+  console_printf("Clock speed: %d\r\n", config.clock_speed);
+
+  if (config.mac_dwell > 0)
+  {
+    console_printf("MAC dwell: %d s\r\n", config.mac_dwell);
+  }
+  return CMD_DONE;
+}
+
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_boot(int nTokens, char **tokens)
+{
+  int16_t i;
+
+  if (nTokens > 2)
+  {
+    return CMD_INVALID;
+  }
+
+  for (i = 0; i < BOOT_PHASES; i++)
+  {
+    if (boot_phases_reached & (1 << i))
+    {
+      console_printf("%s: %d ms\r\n", boot_phase_name[i],
+                     boot_phase_us[i] / 1000);
+    }
+    else
+    {
+      console_printf("%s: -\r\n", boot_phase_name[i]);
     }
+  }
 
-    if (nTokens == 2 && strcmp(tokens[1], "stats") == 0)
+  console_printf("MAC rotations: %d", mac_rotations);
+  if (mac_rotations > 0 && !mac_rotation_pending)
+  {
+    console_printf(", last AP up after %d ms", mac_rotation_ap_up_us / 1000);
+    // A restart would have taken at least until the uplink was back
+    if ((boot_phases_reached & (1 << BOOT_STA_GOT_IP)) &&
+        boot_phase_us[BOOT_STA_GOT_IP] > mac_rotation_ap_up_us)
     {
-      uint32_t time = (uint32_t)(get_long_systime()/1000000);
-      int16_t i;
-      enum phy_mode phy;
-      struct dhcps_pool *p;
-      os_sprintf(response, "System uptime: %d:%02d:%02d\r\n",
-                 time/3600, (time%3600)/60, time%60);
-      to_console(response);
-      os_sprintf(response,
-                 "%d KiB in (%d packets)\r\n%d KiB out (%d packets)\r\n",
-      (uint32_t)(Bytes_in/1024), Packets_in,
-      (uint32_t)(Bytes_out/1024), Packets_out);
-      to_console(response);
-#ifdef PHY_MODE
-      phy = wifi_get_phy_mode();
-      os_sprintf(response, "Phy mode: %c\r\n",
-                 phy == PHY_MODE_11B?'b':phy == PHY_MODE_11G?'g':'n');
-      to_console(response);
+      console_printf(", saves >= %d ms per cycle",
+                     (boot_phase_us[BOOT_STA_GOT_IP] - mac_rotation_ap_up_us) / 1000);
+    }
+  }
+  to_console("\r\n");
+  return CMD_DONE;
+}
+
+#ifdef CPU_STATS
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_cpu(int nTokens, char **tokens)
+{
+  int16_t i;
+  uint32_t mhz = system_get_cpu_freq();
+  uint64_t wall = cpu_stats_wall_us() * mhz, busy = 0;
+
+  if (nTokens == 3 && strcmp(tokens[2], "clear") == 0)
+  {
+    cpu_stats_clear();
+    console_reply("CPU stats cleared\r\n");
+    return CMD_DONE;
+  }
+
+  // Shares in hundredths of a percent of the cycles since clear
+  console_printf("CPU at %d MHz over %d s\r\n",
+                 mhz, (uint32_t)(wall / mhz / 1000000));
+  for (i = 0; i < CPU_CONTEXTS && wall > 0; i++)
+  {
+    const cpu_stats_t *cpu = &cpu_stats[i];
+    uint32_t share = (uint32_t)(cpu->cycles * 10000 / wall);
+
+    if (cpu->calls == 0)
+    {
+      continue;
+    }
+    busy += cpu->cycles;
+    console_printf("%s: %d.%02d%%, %d calls, avg %d max %d cycles\r\n",
+                   cpu_context_name[i], share / 100, share % 100, cpu->calls,
+                   (uint32_t)(cpu->cycles / cpu->calls), cpu->max);
+  }
+  if (wall > busy)
+  {
+    uint32_t share = (uint32_t)((wall - busy) * 10000 / wall);
+
+    console_printf("SDK, WiFi and idle: %d.%02d%%\r\n",
+                   share / 100, share % 100);
+  }
+  return CMD_DONE;
+}
 #endif
-      os_sprintf(response, "Free mem: %d\r\n", system_get_free_heap_size());
-      to_console(response);
-      if (connected)
+
+#ifdef LATENCY_STATS
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_latency(int nTokens, char **tokens)
+{
+  int16_t i;
+  uint32_t mhz = system_get_cpu_freq();
+  int16_t hook, b;
+
+  if (nTokens == 3 && strcmp(tokens[2], "clear") == 0)
+  {
+    latency_clear();
+    console_reply("Latency histograms cleared\r\n");
+    return CMD_DONE;
+  }
+
+  // The hook's own time and lwIP's, then "bucket:count" for each
+  // bucket used, with the lower bound of the bucket in cycles
+  for (hook = 0; hook < LATENCY_HOOKS; hook++)
+  {
+    for (i = 0; i < 2; i++)
+    {
+      const latency_hist_t *hist = latency_get(hook, i == 1);
+
+      if (hist->count == 0)
       {
-        os_sprintf(response, "External IP-address: " IPSTR "\r\n", IP2STR(&my_ip));
+        continue;
       }
-      else
+      console_printf("%s %s: %d, avg %d max %d cycles (%d us)\r\n ",
+                     latency_hook_name[hook], i == 1 ? "lwIP" : "hook",
+                     hist->count, (uint32_t)(hist->sum / hist->count),
+                     hist->max, hist->max / mhz);
+      for (b = 0; b < LATENCY_BUCKETS; b++)
       {
-        os_sprintf(response, "Not connected to AP\r\n");
+        if (hist->bucket[b] > 0)
+        {
+          console_printf(" %d:%d", 1 << b, hist->bucket[b]);
+        }
       }
-      to_console(response);
+      to_console("\r\n");
+    }
+  }
+  return CMD_DONE;
+}
+#endif
 
-      os_sprintf(response,
-                 "%d Station%s connected to SoftAP\r\n",
-                 wifi_softap_get_station_num(),
-      wifi_softap_get_station_num()==1?"":"s");
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_stats(int nTokens, char **tokens)
+{
+  uint32_t time = (uint32_t)(get_long_systime()/1000000);
+  int16_t i;
+  enum phy_mode phy;
+  struct dhcps_pool *p;
 
-      to_console(response);
-      for (i = 0; p = dhcps_get_mapping(i); i++)
-      {
-        os_sprintf(response,
-                   "Station: %02x:%02x:%02x:%02x:%02x:%02x - "  IPSTR "\r\n",
+  if (nTokens > 2)
+  {
+    return CMD_INVALID;
+  }
+  console_printf("System uptime: %d:%02d:%02d\r\n",
+                 time/3600, (time%3600)/60, time%60);
+  console_printf("%d KiB in (%d packets)\r\n%d KiB out (%d packets)\r\n",
+  (uint32_t)(Bytes_in/1024), Packets_in,
+  (uint32_t)(Bytes_out/1024), Packets_out);
+  if (stats_before.boots > 0)
+  {
+    rtc_stats_t total;
+
+    stats_total(&total);
+    time = (uint32_t)(total.uptime_us/1000000);
+    console_printf("Since power on: %d boots, %d MAC cycles, uptime %d:%02d:%02d\r\n",
+                   total.boots, total.cycles,
+                   time/3600, (time%3600)/60, time%60);
+    console_printf("%d KiB in (%d packets)\r\n%d KiB out (%d packets)\r\n",
+    (uint32_t)(total.bytes_in/1024), total.packets_in,
+    (uint32_t)(total.bytes_out/1024), total.packets_out);
+  }
+  console_printf("In: %d/%d/%d B/s, %d/%d/%d packets/s (now/avg/peak)\r\n",
+                 rate_bytes_in.now, rate_bytes_in.avg_scaled >> RATE_EWMA_SHIFT,
+                 rate_bytes_in.peak, rate_packets_in.now,
+                 rate_packets_in.avg_scaled >> RATE_EWMA_SHIFT,
+                 rate_packets_in.peak);
+  console_printf("Out: %d/%d/%d B/s, %d/%d/%d packets/s (now/avg/peak)\r\n",
+                 rate_bytes_out.now, rate_bytes_out.avg_scaled >> RATE_EWMA_SHIFT,
+                 rate_bytes_out.peak, rate_packets_out.now,
+                 rate_packets_out.avg_scaled >> RATE_EWMA_SHIFT,
+                 rate_packets_out.peak);
+#ifdef PHY_MODE
+  phy = wifi_get_phy_mode();
+  console_printf("Phy mode: %c\r\n",
+                 phy == PHY_MODE_11B?'b':phy == PHY_MODE_11G?'g':'n');
+#endif
+  console_printf("Free mem: %d, min %d, largest block %d\r\n",
+                 system_get_free_heap_size(), mem_min_free(),
+                 mem_largest_block());
+  to_console("Allocs/frees/failed:");
+  for (i = 0; i < MEM_USERS; i++)
+  {
+    const mem_user_stats_t *mem = mem_user_stats(i);
+
+    console_printf(" %s %d/%d/%d", mem_user_name[i],
+                   mem->allocs, mem->frees, mem->failed);
+  }
+  to_console("\r\n");
+  console_printf("Task events: %d posted, %d coalesced, %d dropped\r\n",
+                 task_stats.posted, task_stats.coalesced, task_stats.dropped);
+  if (connected)
+  {
+    console_printf("External IP-address: " IPSTR "\r\n", IP2STR(&my_ip));
+  }
+  else
+  {
+    to_console("Not connected to AP\r\n");
+  }
+
+  console_printf("%d Station%s connected to SoftAP\r\n",
+                 wifi_softap_get_station_num(),
+  wifi_softap_get_station_num()==1?"":"s");
+  for (i = 0; p = dhcps_get_mapping(i); i++)
+  {
+    console_printf("Station: %02x:%02x:%02x:%02x:%02x:%02x - "  IPSTR,
                    p->mac[0], p->mac[1], p->mac[2], p->mac[3], p->mac[4],
                    p->mac[5], IP2STR(&p->ip));
-        to_console(response);
-      }
+    console_sta_stats(sta_stats_find(p->mac));
+  }
+  // Stations with a static address, or whose lease has gone
+  for (i = 0; i < STA_STATS_SLOTS; i++)
+  {
+    sta_stats_t *sta = sta_stats_get(i);
+    int16_t j;
 
-      if (config.ap_watchdog >= 0 || config.client_watchdog >= 0)
-      {
-        os_sprintf(response, "AP watchdog: %d Client watchdog: %d\r\n",
-                   ap_watchdog_cnt, client_watchdog_cnt);
-        to_console(response);
-      }
-      goto command_handled_2;
+    if (sta == NULL)
+    {
+      continue;
+    }
+    for (j = 0; (p = dhcps_get_mapping(j)) &&
+                os_memcmp(p->mac, sta->mac, 6) != 0; j++)
+    {
+    }
+    if (p == NULL)
+    {
+      console_printf("Station: " MACSTR " - no lease", MAC2STR(sta->mac));
+      console_sta_stats(sta);
     }
   }
 
-  if (strcmp(tokens[0], "connect") == 0)
+  if (config.ap_watchdog >= 0 || config.client_watchdog >= 0)
   {
-    if (nTokens > 1)
-    {
-      os_sprintf(response, INVALID_NUMARGS);
-      goto command_handled;
-    }
+    console_printf("AP watchdog: %d ms Client watchdog: %d ms\r\n",
+                   watchdog_remaining_ms(&ap_watchdog),
+                   watchdog_remaining_ms(&client_watchdog));
+  }
+  // A reset ends the boot, all of them are from before this one
+  if (stats_before.ap_watchdog_resets > 0 ||
+      stats_before.client_watchdog_resets > 0)
+  {
+    console_printf("Watchdog resets since power on: AP %d, client %d\r\n",
+                   stats_before.ap_watchdog_resets,
+                   stats_before.client_watchdog_resets);
+  }
+  return CMD_DONE;
+}
 
-    user_set_station_config();
-    os_sprintf(response, "Trying to connect to ssid %s, password: %s\r\n", config.ssid, config.password);
+static CMD_RESULT ICACHE_FLASH_ATTR
+show_trace(int nTokens, char **tokens)
+{
+  uint32_t seq, first, next, n;
+  trace_rec_t rec;
+
+  // One page at a time, host/trace_decode turns the pages into a
+  // timeline
+  trace_range(&first, &next);
+  seq = nTokens == 3 ? atoi(tokens[2]) : first;
+  if (seq < first)
+  {
+    seq = first;
+  }
+  console_printf("Trace %d-%d at %x\r\n", first, next, system_get_time());
+  for (n = 0; n < TRACE_DUMP_PAGE && trace_get(seq, &rec); n++, seq++)
+  {
+    console_printf("T %d %x %d %d %x\r\n",
+                   seq, rec.time, rec.event, rec.arg0, rec.arg1);
+  }
+  if (seq < next)
+  {
+    console_printf("More: show trace %d\r\n", seq);
+  }
+  return CMD_DONE;
+}
+
+// Sorted by name
+static const console_cmd_t show_cmds[] =
+{
+  {"boot", show_boot},
+  {"config", show_config},
+#ifdef CPU_STATS
+  {"cpu", show_cpu},
+#endif
+#ifdef LATENCY_STATS
+  {"latency", show_latency},
+#endif
+  {"stats", show_stats},
+  {"trace", show_trace},
+};
 
-    wifi_station_disconnect();
-    wifi_station_connect();
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_show(int nTokens, char **tokens)
+{
+  const console_cmd_t *cmd;
 
-    goto command_handled;
+  if (nTokens == 1)
+  {
+    return show_config(nTokens, tokens);
   }
+  cmd = console_lookup(show_cmds, ARRAY_LEN(show_cmds), sizeof(show_cmds[0]),
+                       tokens[1]);
+  return cmd != NULL ? cmd->handler(nTokens, tokens) : CMD_INVALID;
+}
+
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_help(int nTokens, char **tokens)
+{
+  uint16_t i, len;
+
+  to_console("show [config|stats|boot");
+#ifdef CPU_STATS
+  to_console("|cpu [clear]");
+#endif
+#ifdef LATENCY_STATS
+  to_console("|latency [clear]");
+#endif
+  to_console("|trace [<seq>]]\r\nset <param> <val>, with <param> one of:");
 
-  if (strcmp(tokens[0], "disconnect") == 0)
+  // Names as they come from the table, wrapped before 80 columns
+  len = 80;
+  for (i = 0; i < ARRAY_LEN(console_params); i++)
   {
-    if (nTokens > 1)
+    len += os_strlen(console_params[i].name) + 1;
+    if (len >= 80)
     {
-      os_sprintf(response, INVALID_NUMARGS);
-      goto command_handled;
+      to_console("\r\n ");
+      len = os_strlen(console_params[i].name) + 1;
     }
+    to_console(" ");
+    to_console((char *)console_params[i].name);
+  }
+  to_console("\r\nsave [config|dhcp]\r\nconnect | disconnect | reset [factory] | mac_list | quit\r\n");
+  return CMD_DONE;
+}
 
-    os_sprintf(response, "Disconnect from ssid\r\n");
-
-    wifi_station_disconnect();
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_mac_list(int nTokens, char **tokens)
+{
+  // List stored HomePass mac addresses
+  int16_t i;
 
-    goto command_handled;
+  to_console("HomePass mac list:\r\n");
+  for (i = 0; i <= MAC_LIST_LENGTH - 1; i++)
+  {
+    console_printf("%02x:%02x:%02x:%02x:%02x:%02x\r\n",
+                   config.mac_list[i][0], config.mac_list[i][1],
+                   config.mac_list[i][2], config.mac_list[i][3],
+                   config.mac_list[i][4], config.mac_list[i][5]);
   }
+  console_printf("\r\n");
+  return CMD_DONE;
+}
 
-  if (strcmp(tokens[0], "save") == 0)
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_connect(int nTokens, char **tokens)
+{
+  if (nTokens > 1)
   {
-    if (nTokens == 1 || (nTokens == 2 && strcmp(tokens[1], "config") == 0))
-    {
-      config.first_run = 0;
-      config_save(&config);
-      os_sprintf(response, "Config saved\r\n");
-      goto command_handled;
-    }
+    console_reply(INVALID_NUMARGS);
+    return CMD_DONE;
+  }
 
-    if (nTokens == 2 && strcmp(tokens[1], "dhcp") == 0)
-    {
-      int16_t i;
-      struct dhcps_pool *p;
+  user_set_station_config();
+  console_reply("Trying to connect to ssid %s, password: %s\r\n", config.ssid, config.password);
 
-      for (i = 0; i<MAX_DHCP && (p = dhcps_get_mapping(i)); i++)
-      {
-        os_memcpy(&config.dhcps_p[i], p, sizeof(struct dhcps_pool));
-      }
-      config.dhcps_entries = i;
-      config_save(&config);
-      os_sprintf(response, "Config and DHCP table saved\r\n");
-      goto command_handled;
-    }
-  }
-  if (strcmp(tokens[0], "reset") == 0)
+  wifi_station_disconnect();
+  wifi_station_connect();
+  return CMD_DONE;
+}
+
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_disconnect(int nTokens, char **tokens)
+{
+  if (nTokens > 1)
   {
-    if (nTokens == 2 && strcmp(tokens[1], "factory") == 0)
-    {
-      config_load_default(&config);
-      config_save(&config);
-    }
+    console_reply(INVALID_NUMARGS);
+    return CMD_DONE;
+  }
 
-    os_printf("Restarting ... \r\n");
-    system_restart(); // if it works this will not return
+  console_reply("Disconnect from ssid\r\n");
 
-    os_sprintf(response, "Reset failed\r\n");
-    goto command_handled;
-  }
+  wifi_station_disconnect();
+  return CMD_DONE;
+}
 
-  if (strcmp(tokens[0], "quit") == 0)
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_save(int nTokens, char **tokens)
+{
+  if (nTokens == 1 || (nTokens == 2 && strcmp(tokens[1], "config") == 0))
   {
-    remote_console_disconnect = 1;
-    os_sprintf(response, "Quitting console\r\n");
-    goto command_handled;
+    config.first_run = 0;
+    config_save(&config);
+    console_reply("Config saved\r\n");
+    return CMD_DONE;
   }
 
-  if (strcmp(tokens[0], "set") == 0)
+  if (nTokens == 2 && strcmp(tokens[1], "dhcp") == 0)
   {
-    /*
-     * For set commands atleast 2 tokens "set" "parameter" "value" is needed
-     * hence the check
-     */
-    if (nTokens < 3)
+    int16_t i;
+    struct dhcps_pool *p;
+
+    for (i = 0; i<MAX_DHCP && (p = dhcps_get_mapping(i)); i++)
     {
-      os_sprintf(response, INVALID_NUMARGS);
-      goto command_handled;
+      os_memcpy(&config.dhcps_p[i], p, sizeof(struct dhcps_pool));
     }
-    else
-    {
-      // atleast 3 tokens, proceed
-      if (strcmp(tokens[1], "ssid") == 0)
-      {
-        // Handle case when ssid has spaces in it
-        // This means the rest of the ssid has been split over the remainder
-        // of the tokens[] array and we need to re-concatenate them
-        // to get the full ssid name.
-        if (nTokens > 3)
-        {
-          char ssid[32] = {};
-          int i;
-
-          // The ssid starts at the 3rd token, position 2 in the tokens
-          // array. Hence i = 2.
-          for (i = 2; i < nTokens; i++)
-          {
-            _strcat(ssid, tokens[i]);
-
-            // Restore the space character between tokens
-            // that form the ssid.
-            // Don't add space after the last token.
-            if (i < nTokens - 1)
-            {
-              _strcat(ssid, " ");
-            }
-          }
-
-          // Copy the recomposed ssid to the config.
-          os_sprintf(config.ssid, "%s", ssid);
-        }
-        else
-        {
-          os_sprintf(config.ssid, "%s", tokens[2]);
-        }
-
-        config.auto_connect = 1;
-        os_sprintf(response, "SSID set (auto_connect = 1)\r\n");
-        goto command_handled;
-      }
-
-      if (strcmp(tokens[1], "password") == 0)
-      {
-        // Handle case when password has spaces in it
-        // This means the rest of the password has been split over the remainder
-        // of the tokens[] array and we need to re-concatenate them
-        // to get the full password.
-        if (nTokens > 3)
-        {
-          char password[64] = {};
-          int i;
-
-          // The password starts at the 3rd token, position 2 in the tokens
-          // array. Hence i = 2.
-          for (i = 2; i < nTokens; i++)
-          {
-            _strcat(password, tokens[i]);
-
-            // Restore the space character between tokens
-            // that form the password.
-            // Don't add space after the last token.
-            if (i < nTokens - 1)
-            {
-              _strcat(password, " ");
-            }
-          }
-
-          // Copy the recomposed password to the config.
-          os_sprintf(config.password, "%s", password);
-        }
-        else
-        {
-          os_sprintf(config.password, "%s", tokens[2]);
-        }
+    config.dhcps_entries = i;
+    config_save(&config);
+    console_reply("Config and DHCP table saved\r\n");
+    return CMD_DONE;
+  }
+  return CMD_INVALID;
+}
 
-        os_sprintf(response, "Password set\r\n");
-        goto command_handled;
-      }
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_reset(int nTokens, char **tokens)
+{
+  if (nTokens == 2 && strcmp(tokens[1], "factory") == 0)
+  {
+    config_load_default(&config);
+    config_save(&config);
+  }
 
-      if (strcmp(tokens[1], "auto_connect") == 0)
-      {
-        config.auto_connect = atoi(tokens[2]);
-        os_sprintf(response, "Auto Connect set\r\n");
-        goto command_handled;
-      }
+  os_printf("Restarting ... \r\n");
+  stats_save();
+  system_restart(); // if it works this will not return
 
-      if (strcmp(tokens[1], "sta_hostname") == 0)
-      {
-        os_sprintf(config.sta_hostname, "%s", tokens[2]);
-        os_sprintf(response, "STA hostname set\r\n");
-        goto command_handled;
-      }
+  console_reply("Reset failed\r\n");
+  return CMD_DONE;
+}
 
-      if (strcmp(tokens[1], "ap_ssid") == 0)
-      {
-        os_sprintf(config.ap_ssid, "%s", tokens[2]);
-        os_sprintf(response, "AP SSID set\r\n");
-        goto command_handled;
-      }
+static CMD_RESULT ICACHE_FLASH_ATTR
+cmd_quit(int nTokens, char **tokens)
+{
+  remote_console_disconnect = 1;
+  console_reply("Quitting console\r\n");
+  return CMD_DONE;
+}
 
-      if (strcmp(tokens[1], "ap_watchdog") == 0)
-      {
-        if (strcmp(tokens[2],"none") == 0)
-        {
-          config.ap_watchdog = ap_watchdog_cnt = -1;
-          os_sprintf(response, "AP watchdog off\r\n");
-          goto command_handled;
-        }
-        int32_t wd_val = atoi(tokens[2]);
-        if (wd_val < 30)
-        {
-          os_sprintf(response, "AP watchdog value invalid\r\n");
-          goto command_handled;
-        }
-        config.ap_watchdog = ap_watchdog_cnt = wd_val;
-        os_sprintf(response,
-                   "AP watchdog set to %d\r\n", config.ap_watchdog);
-        goto command_handled;
-      }
+// Sorted by name
+static const console_cmd_t console_cmds[] =
+{
+  {"connect", cmd_connect},
+  {"disconnect", cmd_disconnect},
+  {"help", cmd_help},
+  {"mac_list", cmd_mac_list},
+  {"quit", cmd_quit},
+  {"reset", cmd_reset},
+  {"save", cmd_save},
+  {"set", cmd_set},
+  {"show", cmd_show},
+};
 
-      if (strcmp(tokens[1], "client_watchdog") == 0)
-      {
-        if (strcmp(tokens[2], "none") == 0)
-        {
-          config.client_watchdog = client_watchdog_cnt = -1;
-          os_sprintf(response, "Client watchdog off\r\n");
-          goto command_handled;
-        }
-        int32_t wd_val = atoi(tokens[2]);
-        if (wd_val < 30)
-        {
-          os_sprintf(response, "Client watchdog value invalid\r\n");
-          goto command_handled;
-        }
-        config.client_watchdog = client_watchdog_cnt = wd_val;
-        os_sprintf(response, "Client watchdog set to %d\r\n", config.client_watchdog);
-        goto command_handled;
-      }
+static void ICACHE_FLASH_ATTR
+console_run_line(char *line)
+{
+  #define MAX_CMD_TOKENS 20
 
-      if (strcmp(tokens[1], "speed") == 0)
-      {
-        uint16_t speed = atoi(tokens[2]);
-        bool succ = system_update_cpu_freq(speed);
-        if (succ)
-        {
-          config.clock_speed = speed;
-        }
-        os_sprintf(response, "Clock speed update %s\r\n",
-                   succ?"successful":"failed");
-        goto command_handled;
-      }
+  char *tokens[MAX_CMD_TOKENS];
+  const console_cmd_t *cmd;
+  CMD_RESULT result = CMD_INVALID;
+  int nTokens;
 
-      if (strcmp(tokens[1], "status_led") == 0)
-      {
-        if (config.status_led <= 16)
-        {
-          easygpio_outputSet (config.status_led, 1);
-        }
-        if (config.status_led == 1)
-        {
-          // Enable output if serial pin was used as status LED
-          system_set_os_print(1);
-        }
-        config.status_led = atoi(tokens[2]);
-        if (config.status_led > 16)
-        {
-          os_sprintf(response, "Status led disabled\r\n");
-          goto command_handled;
-        }
-        if (config.status_led == 1)
-        {
-          // Disable output if serial pin is used as status LED
-          system_set_os_print(0);
-        }
-        easygpio_pinMode(config.status_led, EASYGPIO_NOPULL, EASYGPIO_OUTPUT);
-        easygpio_outputSet (config.status_led, 0);
-        os_sprintf(response, "Status led set to GPIO %d\r\n",
-                   config.status_led);
-        goto command_handled;
-      }
+  nTokens = parse_str_into_tokens(line, tokens, MAX_CMD_TOKENS);
 
-#ifdef PHY_MODE
-      if (strcmp(tokens[1], "phy_mode") == 0)
-      {
-        uint16_t mode = atoi(tokens[2]);
-        bool succ = wifi_set_phy_mode(mode);
-        if (succ)
-        {
-          config.phy_mode = mode;
-        }
-        os_sprintf(response, "Phy mode setting %s\r\n",
-                   succ?"successful":"failed");
-        goto command_handled;
-      }
-#endif
-      if (strcmp(tokens[1], "network") == 0)
-      {
-        config.network_addr.addr = ipaddr_addr(tokens[2]);
-        ip4_addr4(&config.network_addr) = 0;
-        os_sprintf(response, "Network set to %d.%d.%d.%d/24\r\n",
-        IP2STR(&config.network_addr));
-        goto command_handled;
-      }
+  if (nTokens == 0)
+  {
+    char c = '\n';
+    ringbuf_memcpy_into(console_tx_buffer, &c, 1);
+    result = CMD_DONE;
+  }
+  else
+  {
+    cmd = console_lookup(console_cmds, ARRAY_LEN(console_cmds),
+                         sizeof(console_cmds[0]), tokens[0]);
+    if (cmd != NULL)
+    {
+      result = cmd->handler(nTokens, tokens);
+    }
+  }
 
-      if (strcmp(tokens[1], "dns") == 0)
-      {
-        if (os_strcmp(tokens[2], "dhcp") == 0)
-        {
-          config.dns_addr.addr = 0;
-          os_sprintf(response, "DNS from DHCP\r\n");
-        }
-        else
-        {
-          config.dns_addr.addr = ipaddr_addr(tokens[2]);
-          os_sprintf(response, "DNS set to %d.%d.%d.%d\r\n",
-          IP2STR(&config.dns_addr));
-          if (config.dns_addr.addr)
-          {
-            dns_ip.addr = config.dns_addr.addr;
-            dhcps_set_DNS(&dns_ip);
-          }
-        }
-        goto command_handled;
-      }
+  if (result == CMD_INVALID)
+  {
+    console_reply("\r\nInvalid Command\r\n");
+  }
+}
 
-      if (strcmp(tokens[1], "ip") == 0)
-      {
-        if (os_strcmp(tokens[2], "dhcp") == 0)
-        {
-          config.my_addr.addr = 0;
-          os_sprintf(response, "IP from DHCP\r\n");
-        }
-        else
-        {
-          config.my_addr.addr = ipaddr_addr(tokens[2]);
-          os_sprintf(response, "IP address set to %d.%d.%d.%d\r\n",
-                     IP2STR(&config.my_addr));
-        }
-        goto command_handled;
-      }
+/*
+ * Posts of SIG_CONSOLE_RX are coalesced, so there may be several lines
+ * waiting, more than cmd_line holds. It is topped up from the RX buffer
+ * after every line and each line is run on its own, until the buffer is
+ * empty. A line still being typed is kept for the next call.
+ */
+void ICACHE_FLASH_ATTR
+console_handle_command(struct espconn *pespconn)
+{
+  static char cmd_line[MAX_CON_CMD_SIZE+1];
+  static int bytes_count;
+  char *eol;
+  int len;
+  bool ran = false;
 
-      if (strcmp(tokens[1],"netmask") == 0)
-      {
-        config.my_netmask.addr = ipaddr_addr(tokens[2]);
-        os_sprintf(response, "IP netmask set to %d.%d.%d.%d\r\n",
-                   IP2STR(&config.my_netmask));
-        goto command_handled;
-      }
+  currentconn = pespconn;
 
-      if (strcmp(tokens[1],"gw") == 0)
-      {
-        config.my_gw.addr = ipaddr_addr(tokens[2]);
-        os_sprintf(response, "Gateway set to %d.%d.%d.%d\r\n",
-                   IP2STR(&config.my_gw));
-        goto command_handled;
-      }
+  for (;;)
+  {
+    // The UART interrupt keeps filling the buffer while we drain it
+    bytes_count += ringbuf_spsc_get(&cmd_line[bytes_count], console_rx_buffer,
+                                    MAX_CON_CMD_SIZE - bytes_count);
+    cmd_line[bytes_count] = 0;
 
-      if (strcmp(tokens[1], "ap_mac") == 0)
+    eol = os_strchr(cmd_line, '\r');
+    if (eol == NULL)
+    {
+      // No room left for the end of the line, run what there is
+      if (bytes_count < MAX_CON_CMD_SIZE)
       {
-        uint8_t new_ap_mac[6];
-        if (!parse_mac(new_ap_mac, tokens[2]))
-        {
-          os_sprintf(response, INVALID_ARG);
-        }
-        else
-        {
-          wifi_set_macaddr(SOFTAP_IF, new_ap_mac);
-          os_sprintf(response, "AP MAC set\r\n");
-        }
-        goto command_handled;
+        break;
       }
+      eol = &cmd_line[bytes_count];
+    }
+    if (ran)
+    {
+      // Prompt before the next command, as if it had come on its own
+      console_send_response(pespconn, true);
+    }
+    *eol = 0;
+    len = eol - cmd_line + (eol < &cmd_line[bytes_count]);
+    console_run_line(cmd_line);
+    ran = true;
 
-      if (strcmp(tokens[1],"sta_mac") == 0)
-      {
-        if (!parse_mac(config.STA_MAC_address, tokens[2]))
-        {
-          os_sprintf(response, INVALID_ARG);
-        }
-        else
-        {
-          os_sprintf(response, "STA MAC set\r\n");
-        }
-        goto command_handled;
-      }
+    bytes_count -= len;
+    os_memmove(cmd_line, &cmd_line[len], bytes_count + 1);
+  }
 
-      if (strcmp(tokens[1],"bssid") == 0)
-      {
-        if (!parse_mac(config.bssid, tokens[2]))
-        {
-          os_sprintf(response, INVALID_ARG);
-        }
-        else
-        {
-          os_sprintf(response, "bssid set\r\n");
-        }
-        goto command_handled;
-      }
-    }
+  // Its lines may all have been run by the previous call already
+  if (ran)
+  {
+    task_post(SIG_CONSOLE_TX, (ETSParam) pespconn);
   }
+}
 
-  /* Control comes here only if the tokens[0] command is not handled */
-  os_sprintf(response, "\r\nInvalid Command\r\n");
+// Configure the SoftAP netif, once it exists
+void ICACHE_FLASH_ATTR
+softap_ip_config(void)
+{
+  if (!user_set_softap_ip_config())
+  {
+    // Not up yet, try again shortly
+    job_start(&ip_config_job, 100, 0);
+    return;
+  }
+  do_ip_config = false;
+  boot_phase(BOOT_AP_UP);
+  trace(TRACE_AP_ON, current_mac_address_index, 0);
 
-command_handled:
-  to_console("\r\n");
-  to_console(response);
+  if (mac_rotation_pending)
+  {
+    mac_rotation_ap_up_us = system_get_time() - mac_rotation_start_us;
+    mac_rotation_pending = false;
+    os_printf("AP up after %d ms\r\n", mac_rotation_ap_up_us / 1000);
+  }
+}
 
-command_handled_2:
-  system_os_post(0, SIG_CONSOLE_TX, (ETSParam) pespconn);
+// Bring the SoftAP back up with the next StreetPass MAC address. The
+// station interface and its lease stay up, unlike with a restart. A new
+// window starts the AP duty cycle over, otherwise only the MAC changes.
+void ICACHE_FLASH_ATTR
+rotate_mac(bool new_window)
+{
+  mac_rotation_start_us = system_get_time();
+  mac_rotation_pending = true;
+  mac_rotations++;
+
+  current_mac_address_index = mac_bag_next(MAC_LIST_LENGTH);
+  trace(TRACE_MAC_ROTATE, current_mac_address_index, new_window);
+  os_printf("Rotating AP MAC to " MACSTR "\r\n",
+            MAC2STR(config.mac_list[current_mac_address_index]));
+
+  // The SoftAP MAC can only be set while the SoftAP is enabled. Nothing
+  // of this goes to the SDK's flash sectors, they would wear out.
+  wifi_set_opmode_current(STATION_MODE);
+  wifi_set_opmode_current(STATIONAP_MODE);
+  wifi_set_macaddr(SOFTAP_IF, config.mac_list[current_mac_address_index]);
+  user_set_softap_wifi_config();
+  do_ip_config = true;
+  softap_ip_config();
 
-  return;
+  mac_dwell_cnt = 0;
+  if (new_window)
+  {
+    awake_cnt = 0;
+    ap_enabled_cnt = 0;
+  }
 }
 
-bool toggle;
-// Timer cb function
-void ICACHE_FLASH_ATTR
-timer_func(void *arg)
+// Once a second: MAC rotation, AP duty cycle and statistics
+static void ICACHE_FLASH_ATTR
+second_func(void *arg)
 {
-  uint32_t Vcurr;
   uint64_t t_new;
   uint32_t t_diff;
 
-  toggle = !toggle;
-
-  // Check if watchdogs
-  if (toggle)
+  if (config.auto_connect == 1)
   {
-    if (config.auto_connect == 1)
+    // NOTE(m): Switch to a new random StreetPass MAC address from
+    // the list after a while.
+    if (awake_cnt >= config.system_restart_interval)
+    {
+      rotate_mac(true);
+    }
+    else
+    {
+      awake_cnt++;
+    }
+
+    // NOTE(m): Switch off the access point after a while if
+    // it's not switched off already.
+    if (wifi_get_opmode() == STATIONAP_MODE)
     {
-      // NOTE(m): Restart the system after a while to set a new random
-      // StreetPass MAC address from the list.
-      if (awake_cnt >= config.system_restart_interval)
+      if (ap_enabled_cnt >= config.ap_enable_duration)
       {
-        system_restart();
+        ap_enabled_cnt = 0;
+        {
+          wifi_set_opmode_current(STATION_MODE);
+          trace(TRACE_AP_OFF, 0, 0);
+        }
       }
       else
       {
-        awake_cnt++;
-      }
+        ap_enabled_cnt++;
 
-      // NOTE(m): Switch off the access point after a while if
-      // it's not switched off already.
-      if (wifi_get_opmode() == STATIONAP_MODE)
-      {
-        if (ap_enabled_cnt >= config.ap_enable_duration)
-        {
-          ap_enabled_cnt = 0;
-          {
-            wifi_set_opmode(STATION_MODE);
-          }
-        }
-        else
+        // Show several MACs within one window, each for mac_dwell
+        // seconds, unless the window is over by then anyway
+        if (config.mac_dwell > 0 && ++mac_dwell_cnt >= config.mac_dwell &&
+            ap_enabled_cnt < config.ap_enable_duration)
         {
-          ap_enabled_cnt++;
+          rotate_mac(false);
         }
       }
     }
+  }
 
-    if (ap_watchdog_cnt >= 0)
-    {
-      if (ap_watchdog_cnt == 0)
-      {
-        os_printf("AP watchdog reset\r\n");
-        system_restart();
-      }
-      ap_watchdog_cnt--;
-    }
+  // Once a second, so a crash or a hardware watchdog loses at most that
+  stats_save();
 
-    if (client_watchdog_cnt >= 0)
-    {
-      if (client_watchdog_cnt == 0)
-      {
-        os_printf("Client watchdog reset\r\n");
-        system_restart();
-      }
-      client_watchdog_cnt--;
-    }
-  }
+  mem_sample();
 
-  if (config.status_led <= 16)
+  t_new = get_long_systime();
+  uptime_s = (uint32_t)(t_new / 1000000);
+
+  // Rates over the time that actually passed
+  if (t_new > t_old)
   {
-    easygpio_outputSet (config.status_led, toggle && connected);
+    t_diff = (uint32_t)(t_new - t_old);
+    rate_update(&rate_bytes_in, (uint32_t)(Bytes_in - Bytes_in_last), t_diff);
+    rate_update(&rate_bytes_out, (uint32_t)(Bytes_out - Bytes_out_last), t_diff);
+    rate_update(&rate_packets_in, Packets_in - Packets_in_last, t_diff);
+    rate_update(&rate_packets_out, Packets_out - Packets_out_last, t_diff);
+    Bytes_in_last = Bytes_in;
+    Bytes_out_last = Bytes_out;
+    Packets_in_last = Packets_in;
+    Packets_out_last = Packets_out;
+    t_old = t_new;
   }
+}
 
-  // Do we still have to configure the AP netif?
-  if (do_ip_config)
+static void ICACHE_FLASH_ATTR
+watchdog_expired(watchdog_t *wd)
+{
+  bool ap = wd == &ap_watchdog;
+  rtc_stats_t total;
+
+  os_printf("%s watchdog reset\r\n", ap ? "AP" : "Client");
+  // Into the totals before they are saved for the next boot
+  if (ap)
+  {
+    stats_before.ap_watchdog_resets++;
+  }
+  else
   {
-    user_set_softap_ip_config();
-    do_ip_config = false;
+    stats_before.client_watchdog_resets++;
   }
+  // The restart wipes the trace, the next boot records the expiry
+  stats_total(&total);
+  total.watchdog_reset = ap ? 1 : 2;
+  total.watchdog_reset_s = wd->timeout_s;
+  rtc_stats_save(&total);
+  system_restart();
+}
 
-  t_new = get_long_systime();
+// Blinks the status LED: on for 900 ms and off for 100 ms while connected
+static void ICACHE_FLASH_ATTR
+led_func(void *arg)
+{
+  static bool led_on;
+
+  if (config.status_led > 16)
+  {
+    return;
+  }
+  led_on = !led_on;
+  easygpio_outputSet (config.status_led, led_on && connected);
+  job_start(&led_job, led_on ? 900 : 100, 0);
+}
 
-  os_timer_arm(&ptimer, toggle?900:100, 0);
+// Until the SoftAP netif is up
+static void ICACHE_FLASH_ATTR
+ip_config_func(void *arg)
+{
+  if (do_ip_config)
+  {
+    softap_ip_config();
+  }
 }
 
 //Priority 0 Task
 static void ICACHE_FLASH_ATTR
 user_procTask(os_event_t *events)
 {
+  CPU_ENTER(cpu);
   //os_printf("Sig: %d\r\n", events->sig);
+  task_taken(events->sig);
 
   switch(events->sig)
   {
@@ -997,6 +1707,7 @@ user_procTask(os_event_t *events)
       os_printf("Spurious Signal received\r\n");
     } break;
   }
+  CPU_EXIT(cpu, CPU_TASK + (events->sig < CPU_TASK_SIGNALS ? events->sig : 0));
 }
 
 /* Callback called when the connection state of the module with an Access Point changes */
@@ -1015,6 +1726,8 @@ wifi_handle_event_cb(System_Event_t *evt)
                 evt->event_info.connected.ssid,
                 evt->event_info.connected.channel);
       my_channel = evt->event_info.connected.channel;
+      boot_phase(BOOT_STA_CONNECTED);
+      trace(TRACE_STA_CONNECTED, my_channel, 0);
     } break;
 
     case EVENT_STAMODE_DISCONNECTED:
@@ -1023,6 +1736,7 @@ wifi_handle_event_cb(System_Event_t *evt)
                 evt->event_info.disconnected.ssid,
                 evt->event_info.disconnected.reason);
       connected = false;
+      trace(TRACE_STA_DISCONNECTED, evt->event_info.disconnected.reason, 0);
     } break;
 
     case EVENT_STAMODE_AUTHMODE_CHANGE:
@@ -1048,15 +1762,24 @@ wifi_handle_event_cb(System_Event_t *evt)
 
       my_ip = evt->event_info.got_ip.ip;
       connected = true;
+      boot_phase(BOOT_STA_GOT_IP);
+      trace(TRACE_STA_GOT_IP, 0, my_ip.addr);
 
       patch_netif(my_ip, my_input_sta, &orig_input_sta, my_output_sta, &orig_output_sta, false);
 
       // Post a Server Start message as the IP has been acquired to Task with priority 0
-      system_os_post(user_procTaskPrio, SIG_START_SERVER, 0 );
+      task_post(SIG_START_SERVER, 0);
+    } break;
+
+    case EVENT_STAMODE_DHCP_TIMEOUT:
+    {
+      trace(TRACE_STA_DHCP_TIMEOUT, 0, 0);
     } break;
 
     case EVENT_SOFTAPMODE_STACONNECTED:
     {
+      trace(TRACE_AP_STA_JOIN, evt->event_info.sta_connected.aid,
+            trace_mac(evt->event_info.sta_connected.mac));
       os_sprintf(mac_str, MACSTR, MAC2STR(evt->event_info.sta_connected.mac));
       os_printf("station: %s join, AID = %d\r\n",
                 mac_str, evt->event_info.sta_connected.aid);
@@ -1072,6 +1795,8 @@ wifi_handle_event_cb(System_Event_t *evt)
                  MAC2STR(evt->event_info.sta_disconnected.mac));
       os_printf("station: %s leave, AID = %d\r\n", mac_str,
                 evt->event_info.sta_disconnected.aid);
+      trace(TRACE_AP_STA_LEAVE, evt->event_info.sta_disconnected.aid,
+            trace_mac(evt->event_info.sta_disconnected.mac));
     } break;
 
     default:
@@ -1096,11 +1821,12 @@ user_set_softap_wifi_config(void)
   // how many stations can connect to ESP8266 softAP at most.
   apConfig.max_connection = MAX_CLIENTS;
 
-  // Set ESP8266 softap config
-  wifi_softap_set_config(&apConfig);
+  // Set ESP8266 softap config, for now only: it is set again at every
+  // boot and on every MAC rotation, flash would wear out
+  wifi_softap_set_config_current(&apConfig);
 }
 
-void ICACHE_FLASH_ATTR
+bool ICACHE_FLASH_ATTR
 user_set_softap_ip_config(void)
 {
   struct ip_info info;
@@ -1114,7 +1840,7 @@ user_set_softap_ip_config(void)
   for (nif = netif_list; nif != NULL && nif->num == 0; nif = nif->next);
   if (nif == NULL)
   {
-    return;
+    return false;
   }
 
   // If is not 1, set it to 1.
@@ -1151,6 +1877,7 @@ user_set_softap_ip_config(void)
                         &config.dhcps_p[i].mac[0], 100000 /* several months */);
     }
   }
+  return true;
 }
 
 void ICACHE_FLASH_ATTR
@@ -1162,7 +1889,7 @@ user_set_station_config(void)
   /* Setup AP credentials */
   os_sprintf(stationConf.ssid, "%s", config.ssid);
   os_sprintf(stationConf.password, "%s", config.password);
-  if (*(int*)config.bssid != 0)
+  if (os_memcmp(config.bssid, "\0\0\0\0\0", 6) != 0)
   {
     stationConf.bssid_set = 1;
     os_memcpy(stationConf.bssid, config.bssid, 6);
@@ -1182,13 +1909,26 @@ user_set_station_config(void)
 
 #define RANDOM_REG (*(volatile u32 *)0x3FF20E44)
 
+static void ICACHE_FLASH_ATTR
+user_init_done(void)
+{
+  boot_phase(BOOT_INIT_DONE);
+
+  // The SoftAP netif exists now, no need to wait for the first tick
+  if (do_ip_config)
+  {
+    softap_ip_config();
+  }
+}
+
 void ICACHE_FLASH_ATTR
 user_init()
 {
-  // Generate random seed for rand() function
-  srand(system_get_rtc_time());
-  // Generate random mac address index
-  current_mac_address_index = random_mac_index();
+  boot_phase(BOOT_USER_INIT);
+  trace(TRACE_BOOT, 0, 0);
+
+  // Next StreetPass mac address, none repeats before all were used
+  current_mac_address_index = mac_bag_next(MAC_LIST_LENGTH);
 
   struct ip_info info;
 
@@ -1198,6 +1938,12 @@ user_init()
   Bytes_in = Bytes_out = Bytes_in_last = Bytes_out_last = 0,
   Packets_in = Packets_out = Packets_in_last = Packets_out_last = 0;
   t_old = 0;
+  rtc_stats_load(&stats_before);
+  if (stats_before.watchdog_reset != 0)
+  {
+    trace(TRACE_WATCHDOG, stats_before.watchdog_reset - 1,
+          stats_before.watchdog_reset_s);
+  }
 
   console_rx_buffer = ringbuf_new(MAX_CON_CMD_SIZE);
   console_tx_buffer = ringbuf_new(MAX_CON_SEND_SIZE);
@@ -1205,12 +1951,18 @@ user_init()
   gpio_init();
   init_long_systime();
 
+  jobs_init();
+  job_setfn(&second_job, second_func, NULL);
+  job_setfn(&led_job, led_func, NULL);
+  job_setfn(&ip_config_job, ip_config_func, NULL);
+
   UART_init_console(BIT_RATE_115200, 0, console_rx_buffer, console_tx_buffer);
 
   os_printf("\r\n\r\nESPerPass %s starting\r\n", ESPERPASS_VERSION);
 
   // Load config
   config_load(&config);
+  boot_phase(BOOT_CONFIG_LOADED);
 
   // Config GPIO pin as output
   if (config.status_led == 1)
@@ -1219,8 +1971,10 @@ user_init()
     system_set_os_print(0);
   }
 
-  ap_watchdog_cnt = config.ap_watchdog;
-  client_watchdog_cnt = config.client_watchdog;
+  watchdog_init(&ap_watchdog, watchdog_expired);
+  watchdog_init(&client_watchdog, watchdog_expired);
+  watchdog_set(&ap_watchdog, config.ap_watchdog);
+  watchdog_set(&client_watchdog, config.client_watchdog);
 
   if (config.status_led <= 16)
   {
@@ -1289,12 +2043,18 @@ user_init()
   }
 
   system_update_cpu_freq(config.clock_speed);
+  cpu_stats_clear();
 
-  // Start the timer
-  os_timer_setfn(&ptimer, timer_func, 0);
-  os_timer_arm(&ptimer, 500, 0);
+  // Start the periodic jobs
+  job_start(&second_job, 500, 1000);
+  if (config.status_led <= 16)
+  {
+    job_start(&led_job, 500, 0);
+  }
 
   // Start task
   system_os_task(user_procTask, user_procTaskPrio, user_procTaskQueue,
                  user_procTaskQueueLen);
+
+  system_init_done_cb(user_init_done);
 }
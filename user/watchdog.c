@@ -0,0 +1,92 @@
+#include "c_types.h"
+#include "osapi.h"
+
+#include "watchdog.h"
+#include "sys_time.h"
+
+// last_us wraps after 71 minutes, it must be looked at more often
+#define WATCHDOG_MAX_SLEEP_MS (30 * 60 * 1000)
+
+// Brings active_us up to date with the last activity
+static void ICACHE_FLASH_ATTR
+watchdog_refresh(watchdog_t *wd)
+{
+  uint32_t last = wd->last_us;
+
+  if (last != wd->seen_us)
+  {
+    // Newer than the last look, so less than 71 minutes ago
+    wd->seen_us = last;
+    wd->active_us = get_long_systime() - (system_get_time() - last);
+  }
+}
+
+static uint64_t ICACHE_FLASH_ATTR
+watchdog_deadline(const watchdog_t *wd)
+{
+  return wd->active_us + (uint64_t)wd->timeout_s * 1000000;
+}
+
+static void ICACHE_FLASH_ATTR
+watchdog_func(void *arg)
+{
+  watchdog_t *wd = arg;
+  uint64_t now, deadline;
+  uint64_t delay_ms;
+
+  watchdog_refresh(wd);
+  now = get_long_systime();
+  deadline = watchdog_deadline(wd);
+  if (now >= deadline)
+  {
+    wd->expired(wd);
+    return;
+  }
+  delay_ms = (deadline - now + 999) / 1000;
+  job_start(&wd->job, delay_ms < WATCHDOG_MAX_SLEEP_MS ?
+            (uint32_t)delay_ms : WATCHDOG_MAX_SLEEP_MS, 0);
+}
+
+void ICACHE_FLASH_ATTR
+watchdog_init(watchdog_t *wd, void (*expired)(watchdog_t *wd))
+{
+  wd->timeout_s = -1;
+  wd->expired = expired;
+  job_setfn(&wd->job, watchdog_func, wd);
+}
+
+void ICACHE_FLASH_ATTR
+watchdog_set(watchdog_t *wd, int32_t timeout_s)
+{
+  wd->timeout_s = timeout_s;
+  if (timeout_s < 0)
+  {
+    job_stop(&wd->job);
+    return;
+  }
+  wd->last_us = wd->seen_us = system_get_time();
+  wd->active_us = get_long_systime();
+  // The job works out how long to sleep
+  job_start(&wd->job, 0, 0);
+}
+
+int32_t ICACHE_FLASH_ATTR
+watchdog_remaining_ms(watchdog_t *wd)
+{
+  uint64_t now, deadline, remaining_ms;
+
+  if (wd->timeout_s < 0)
+  {
+    return -1;
+  }
+  watchdog_refresh(wd);
+  now = get_long_systime();
+  deadline = watchdog_deadline(wd);
+  if (now >= deadline)
+  {
+    return 0;
+  }
+  // Clamped, the timeout may be up to 2^31 seconds
+  remaining_ms = (deadline - now) / 1000;
+  return remaining_ms < 0x7fffffff ? (int32_t)remaining_ms : 0x7fffffff;
+}
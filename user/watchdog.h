@@ -0,0 +1,38 @@
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include "c_types.h"
+#include "osapi.h"
+#include "jobs.h"
+
+/*
+ * Calls expired() once there was no activity for timeout_s seconds. The
+ * netif hooks only note the time of the activity, a job checks it when
+ * the deadline comes up and moves the deadline on if there was any.
+ */
+typedef struct watchdog
+{
+  int32_t timeout_s; // < 0 when off
+  uint32_t last_us; // system_get_time() of the last activity
+  uint32_t seen_us; // last_us when the job last looked at it
+  uint64_t active_us; // get_long_systime() of that activity
+  job_t job;
+  void (*expired)(struct watchdog *wd);
+} watchdog_t;
+
+void watchdog_init(watchdog_t *wd, void (*expired)(watchdog_t *wd));
+
+// Starts counting from now, a timeout_s < 0 turns it off
+void watchdog_set(watchdog_t *wd, int32_t timeout_s);
+
+// Inline, it is called for every packet
+static inline void
+watchdog_kick(watchdog_t *wd)
+{
+  wd->last_us = system_get_time();
+}
+
+// Milliseconds until it expires, -1 when off
+int32_t watchdog_remaining_ms(watchdog_t *wd);
+
+#endif